@@ -280,6 +280,47 @@ static void cleanup_all_fds(void)
 	cleanup_fd(srst_fd, srst_gpio);
 }
 
+/*
+ * Shift frame extension: clock n bits with TMS/TDI taken from the LSB-first
+ * vectors following the 16 bit little endian bit count, optionally answering
+ * with the sampled TDO bits.
+ */
+#define MAX_SHIFT_BITS 8192
+
+static void process_shift_frame(int capture)
+{
+	static unsigned char tms[MAX_SHIFT_BITS / 8];
+	static unsigned char tdi[MAX_SHIFT_BITS / 8];
+	static unsigned char tdo[MAX_SHIFT_BITS / 8];
+	unsigned int n = getchar();
+	n |= getchar() << 8;
+	unsigned int bytes = (n + 7) / 8;
+
+	if (n == 0 || n > MAX_SHIFT_BITS) {
+		LOG_ERROR("Invalid shift frame length %u", n);
+		exit(1);
+	}
+
+	if (fread(tms, 1, bytes, stdin) != bytes || fread(tdi, 1, bytes, stdin) != bytes) {
+		LOG_ERROR("Truncated shift frame");
+		exit(1);
+	}
+	memset(tdo, 0, bytes);
+
+	for (unsigned int i = 0; i < n; i++) {
+		int tms_bit = (tms[i / 8] >> (i % 8)) & 1;
+		int tdi_bit = (tdi[i / 8] >> (i % 8)) & 1;
+
+		sysfsgpio_write(0, tms_bit, tdi_bit);
+		if (capture && sysfsgpio_read() == '1')
+			tdo[i / 8] |= 1 << (i % 8);
+		sysfsgpio_write(1, tms_bit, tdi_bit);
+	}
+
+	if (capture)
+		fwrite(tdo, 1, bytes, stdout);
+}
+
 static void process_remote_protocol(void)
 {
 	int c;
@@ -300,6 +341,10 @@ static void process_remote_protocol(void)
 					(d & 1));
 		} else if (c == 'R')
 			putchar(sysfsgpio_read());
+		else if (c == 'X') /* Shift frame extension query */
+			putchar('x');
+		else if (c == 'S' || c == 'T')
+			process_shift_frame(c == 'T');
 		else
 			LOG_ERROR("Unknown command '%c' received", c);
 	}
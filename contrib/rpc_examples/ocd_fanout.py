@@ -0,0 +1,181 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: GPL-3.0-or-later
+
+"""
+OpenOCD fan-out over Tcl RPC: run the same commands on several boards at once.
+
+One OpenOCD process is started per adapter serial number, each one with its
+own Tcl RPC port and with the gdb and telnet servers disabled. The given Tcl
+commands are then sent to all of them in parallel, and the output and the
+result of every board is reported once all of them are done.
+
+OpenOCD drives a single adapter per process, so running one process per
+probe is what lets all boards of a fixture be flashed concurrently.
+
+Example, flashing four boards of a production fixture:
+
+./ocd_fanout.py -s 0669FF55 -s 066AFF49 -s 0670FF48 -s 066BFF53 \\
+    -f interface/stlink.cfg -f target/stm32f1x.cfg \\
+    -c "program firmware.elf verify reset"
+
+Example output:
+[0669FF55] ok     12.4s
+[066AFF49] ok     12.6s
+[0670FF48] FAILED 3.1s
+    Error: init mode failed (unable to connect to the target)
+[066BFF53] ok     12.5s
+3/4 boards ok
+"""
+
+import argparse
+import socket
+import subprocess
+import sys
+import threading
+import time
+
+COMMAND_TOKEN = b'\x1a'
+
+
+def tcl_quote(s):
+    """Quote s as a single Tcl word, whatever braces or brackets it holds."""
+    out = []
+    for c in s:
+        if c == "\n":
+            out.append("\\n")
+        elif c in "\\{}[]$\";" or c.isspace():
+            out.append("\\" + c)
+        else:
+            out.append(c)
+    return "".join(out)
+
+
+class Board:
+    def __init__(self, serial, port, openocd, configs, verbose=False):
+        self.serial = serial
+        self.port = port
+        self.verbose = verbose
+        self.ok = False
+        self.output = ""
+        self.elapsed = 0.0
+
+        args = [openocd, "-c", "adapter serial %s" % serial]
+        for kind, value in configs:
+            args += [kind, value]
+        args += ["-c", "gdb_port disabled", "-c", "telnet_port disabled",
+                 "-c", "tcl_port %d" % port]
+
+        log = None if verbose else subprocess.DEVNULL
+        self.proc = subprocess.Popen(args, stdout=log, stderr=log)
+        self.sock = None
+
+    def connect(self, timeout):
+        deadline = time.monotonic() + timeout
+        while True:
+            if self.proc.poll() is not None:
+                raise RuntimeError("openocd exited with code %d" % self.proc.returncode)
+            try:
+                self.sock = socket.create_connection(("127.0.0.1", self.port))
+                return
+            except OSError:
+                if time.monotonic() > deadline:
+                    raise
+                time.sleep(0.1)
+
+    def send(self, cmd):
+        """Send a command string to TCL RPC. Return the result that was read."""
+        self.sock.sendall(cmd.encode("utf-8") + COMMAND_TOKEN)
+        data = bytes()
+        while not data.endswith(COMMAND_TOKEN):
+            chunk = self.sock.recv(4096)
+            if not chunk:
+                raise RuntimeError("connection closed by openocd")
+            data += chunk
+        return data[:-1].decode("utf-8", errors="replace")
+
+    def run(self, commands, timeout):
+        start = time.monotonic()
+        try:
+            self.connect(timeout)
+            for cmd in commands:
+                # catch returns 0 on success, the captured log goes to a variable
+                rc = self.send("catch {capture %s} __fanout_result"
+                               % tcl_quote(cmd))
+                self.output += self.send("set __fanout_result")
+                if rc.strip() != "0":
+                    break
+            else:
+                self.ok = True
+        except (OSError, RuntimeError) as e:
+            self.output += str(e)
+        self.elapsed = time.monotonic() - start
+
+    def close(self):
+        if self.sock:
+            try:
+                self.send("shutdown")
+            except (OSError, RuntimeError):
+                pass
+            self.sock.close()
+        try:
+            self.proc.wait(timeout=5)
+        except subprocess.TimeoutExpired:
+            self.proc.kill()
+
+
+class ConfigAction(argparse.Action):
+    """Keep -f and -c arguments in command line order."""
+    def __call__(self, parser, namespace, values, option_string=None):
+        namespace.configs.append((option_string, values))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0].strip())
+    parser.add_argument("-s", "--serial", action="append", required=True,
+                        help="adapter serial number, once per board")
+    parser.add_argument("-f", dest="configs", action=ConfigAction,
+                        help="configuration file passed to every openocd")
+    parser.add_argument("--config-command", "-C", dest="configs", action=ConfigAction,
+                        metavar="CMD", help="config command passed to every openocd")
+    parser.add_argument("-c", "--command", dest="commands", action="append", required=True,
+                        help="Tcl command to run on every board after init")
+    parser.add_argument("--openocd", default="openocd", help="openocd executable")
+    parser.add_argument("--base-port", type=int, default=6670,
+                        help="Tcl RPC port of the first board")
+    parser.add_argument("--timeout", type=float, default=10.0,
+                        help="seconds to wait for openocd to start")
+    parser.add_argument("-v", "--verbose", action="store_true",
+                        help="show the openocd logs")
+    parser.set_defaults(configs=[])
+    args = parser.parse_args()
+
+    # the -C commands are passed as plain -c to openocd
+    configs = [("-c" if kind in ("-C", "--config-command") else kind, value)
+               for kind, value in args.configs]
+
+    boards = [Board(serial, args.base_port + i, args.openocd, configs, args.verbose)
+              for i, serial in enumerate(args.serial)]
+    try:
+        threads = [threading.Thread(target=b.run, args=(args.commands, args.timeout))
+                   for b in boards]
+        for t in threads:
+            t.start()
+        for t in threads:
+            t.join()
+    finally:
+        for b in boards:
+            b.close()
+
+    for b in boards:
+        print("[%s] %-6s %.1fs" % (b.serial, "ok" if b.ok else "FAILED", b.elapsed))
+        if not b.ok or args.verbose:
+            for line in b.output.strip().splitlines():
+                print("    " + line)
+
+    passed = sum(b.ok for b in boards)
+    print("%d/%d boards ok" % (passed, len(boards)))
+    return 0 if passed == len(boards) else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -176,6 +176,36 @@ static int aducm360_erase(struct flash_bank *bank, unsigned int first,
 	return res;
 }
 
+/* ----------------------------------------------------------------------- */
+static int aducm360_write_block_sync_prepare(struct target *target, void *priv,
+		uint32_t source, uint32_t offset, uint32_t count, struct reg_param *reg_params)
+{
+	uint32_t *address = priv;
+
+	/* Set the arguments for the helper */
+	buf_set_u32(reg_params[0].value, 0, 32, source);				/*SRC     */
+	buf_set_u32(reg_params[1].value, 0, 32, *address + offset);	/*DST     */
+	buf_set_u32(reg_params[2].value, 0, 32, count * 4);			/*COUNT   */
+	buf_set_u32(reg_params[3].value, 0, 32, 0);					/*NOT USED*/
+	return ERROR_OK;
+}
+
+static int aducm360_write_block_sync_check(struct target *target, void *priv,
+		struct reg_param *reg_params)
+{
+	uint32_t res = buf_get_u32(reg_params[4].value, 0, 32);
+	if (res) {
+		LOG_ERROR("aducm360 fast sync algorithm reports an error (%02" PRIX32 ")", res);
+		return ERROR_FAIL;
+	}
+	return ERROR_OK;
+}
+
+static const struct target_pingpong_ops aducm360_write_block_sync_ops = {
+	.prepare = aducm360_write_block_sync_prepare,
+	.check = aducm360_write_block_sync_check,
+};
+
 /* ----------------------------------------------------------------------- */
 static int aducm360_write_block_sync(
 		struct flash_bank *bank,
@@ -191,7 +221,6 @@ static int aducm360_write_block_sync(
 	struct reg_param        reg_params[8];
 	int                     retval = ERROR_OK;
 	uint32_t                entry_point = 0, exit_point = 0;
-	uint32_t                res;
 	struct armv7m_algorithm armv7m_algo;
 
 	static const uint32_t aducm360_flash_write_code[] = {
@@ -230,15 +259,12 @@ static int aducm360_write_block_sync(
 	entry_point = helper->address;
 
 	/*  ----- Allocate space in the target's RAM for the user application's object code -----  */
-	while (target_alloc_working_area_try(target, target_buffer_size, &target_buffer) != ERROR_OK) {
-		LOG_WARNING("couldn't allocate a buffer space of 0x%08" PRIx32 "bytes in the target's SRAM.",
-				target_buffer_size);
-		target_buffer_size /= 2;
-		if (target_buffer_size <= 256) {		/* No room available */
-			LOG_WARNING("no large enough working area available, can't do block memory writes");
-			target_free_working_area(target, helper);
-			return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
-		}
+	target_buffer_size = MIN(target_buffer_size, target_get_working_area_avail(target));
+	if (target_buffer_size <= 256 ||		/* No room available */
+			target_alloc_working_area_try(target, target_buffer_size, &target_buffer) != ERROR_OK) {
+		LOG_WARNING("no large enough working area available, can't do block memory writes");
+		target_free_working_area(target, helper);
+		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
 	}
 
 	/* ----- Prepare the target for the helper ----- */
@@ -252,37 +278,13 @@ static int aducm360_write_block_sync(
 	init_reg_param(&reg_params[4], "r4", 32, PARAM_IN);	 /*RESULT   */
 
 	/*  ===== Execute the Main Programming Loop! ===== */
-	while (count > 0) {
-		uint32_t thisrun_count = (count > target_buffer_size) ? target_buffer_size : count;
-
-		/* ----- Upload the chunk ----- */
-		retval = target_write_buffer(target, target_buffer->address, thisrun_count, buffer);
-		if (retval != ERROR_OK)
-			break;
-		/* Set the arguments for the helper */
-		buf_set_u32(reg_params[0].value, 0, 32, target_buffer->address);	/*SRC     */
-		buf_set_u32(reg_params[1].value, 0, 32, address);					/*DST     */
-		buf_set_u32(reg_params[2].value, 0, 32, thisrun_count);				/*COUNT   */
-		buf_set_u32(reg_params[3].value, 0, 32, 0);							/*NOT USED*/
-
-		retval = target_run_algorithm(target, 0, NULL, 5,
-				reg_params,	entry_point, exit_point, 10000, &armv7m_algo);
-		if (retval != ERROR_OK) {
-			LOG_ERROR("error executing aducm360 flash write algorithm");
-			break;
-		}
-
-		res = buf_get_u32(reg_params[4].value, 0, 32);
-		if (res) {
-			LOG_ERROR("aducm360 fast sync algorithm reports an error (%02" PRIX32 ")", res);
-			retval = ERROR_FAIL;
-			break;
-		}
-
-		buffer += thisrun_count;
-		address += thisrun_count;
-		count -= thisrun_count;
-	}
+	/* The chunks are uploaded while the helper programs the previous one */
+	retval = target_run_flash_pingpong_algorithm(target, buffer, count / 4, 4,
+			5, reg_params, target_buffer->address, target_buffer_size,
+			entry_point, exit_point, 10000, &armv7m_algo,
+			&aducm360_write_block_sync_ops, &address);
+	if (retval != ERROR_OK)
+		LOG_ERROR("error executing aducm360 flash write algorithm");
 
 	target_free_working_area(target, target_buffer);
 	target_free_working_area(target, helper);
@@ -353,15 +355,12 @@ static int aducm360_write_block_async(
 	entry_point = helper->address;
 
 	/*  ----- Allocate space in the target's RAM for the user application's object code ----- */
-	while (target_alloc_working_area_try(target, target_buffer_size, &target_buffer) != ERROR_OK) {
-		LOG_WARNING("couldn't allocate a buffer space of 0x%08" PRIx32 "bytes in the target's SRAM.",
-				target_buffer_size);
-		target_buffer_size /= 2;
-		if (target_buffer_size <= 256) {		/* No room available */
-			LOG_WARNING("no large enough working area available, can't do block memory writes");
-			target_free_working_area(target, helper);
-			return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
-		}
+	target_buffer_size = MIN(target_buffer_size, target_get_working_area_avail(target));
+	if (target_buffer_size <= 256 ||		/* No room available */
+			target_alloc_working_area_try(target, target_buffer_size, &target_buffer) != ERROR_OK) {
+		LOG_WARNING("no large enough working area available, can't do block memory writes");
+		target_free_working_area(target, helper);
+		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
 	}
 
 	/* ----- Prepare the target for the helper ----- */
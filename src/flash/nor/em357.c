@@ -441,6 +441,43 @@ static int em357_protect(struct flash_bank *bank, int set, unsigned int first,
 	return em357_write_options(bank);
 }
 
+static int em357_write_block_prepare(struct target *target, void *priv,
+	uint32_t source, uint32_t offset, uint32_t count, struct reg_param *reg_params)
+{
+	uint32_t *address = priv;
+
+	buf_set_u32(reg_params[0].value, 0, 32, source);
+	buf_set_u32(reg_params[1].value, 0, 32, *address + offset);
+	buf_set_u32(reg_params[2].value, 0, 32, count);
+	buf_set_u32(reg_params[3].value, 0, 32, 0);
+	return ERROR_OK;
+}
+
+static int em357_write_block_check(struct target *target, void *priv,
+	struct reg_param *reg_params)
+{
+	if (buf_get_u32(reg_params[3].value, 0, 32) & FLASH_PGERR) {
+		LOG_ERROR("flash memory not erased before writing");
+		/* Clear but report errors */
+		target_write_u32(target, EM357_FLASH_SR, FLASH_PGERR);
+		return ERROR_FAIL;
+	}
+
+	if (buf_get_u32(reg_params[3].value, 0, 32) & FLASH_WRPRTERR) {
+		LOG_ERROR("flash memory write protected");
+		/* Clear but report errors */
+		target_write_u32(target, EM357_FLASH_SR, FLASH_WRPRTERR);
+		return ERROR_FAIL;
+	}
+
+	return ERROR_OK;
+}
+
+static const struct target_pingpong_ops em357_write_block_ops = {
+	.prepare = em357_write_block_prepare,
+	.check = em357_write_block_check,
+};
+
 static int em357_write_block(struct flash_bank *bank, const uint8_t *buffer,
 	uint32_t offset, uint32_t count)
 {
@@ -495,17 +532,15 @@ static int em357_write_block(struct flash_bank *bank, const uint8_t *buffer,
 		return retval;
 
 	/* memory buffer */
-	while (target_alloc_working_area_try(target, buffer_size, &source) != ERROR_OK) {
-		buffer_size /= 2;
-		if (buffer_size <= 256) {
-			/* we already allocated the writing code, but failed to get a
-			 * buffer, free the algorithm */
-			target_free_working_area(target, write_algorithm);
-
-			LOG_WARNING(
-				"no large enough working area available, can't do block memory writes");
-			return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
-		}
+	buffer_size = MIN(buffer_size, target_get_working_area_avail(target));
+	if (buffer_size <= 256 ||
+			target_alloc_working_area_try(target, buffer_size, &source) != ERROR_OK) {
+		/* we already allocated the writing code, but failed to get a
+		 * buffer, free the algorithm */
+		target_free_working_area(target, write_algorithm);
+
+		LOG_WARNING("no large enough working area available, can't do block memory writes");
+		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
 	}
 
 	armv7m_info.common_magic = ARMV7M_COMMON_MAGIC;
@@ -516,46 +551,12 @@ static int em357_write_block(struct flash_bank *bank, const uint8_t *buffer,
 	init_reg_param(&reg_params[2], "r2", 32, PARAM_OUT);
 	init_reg_param(&reg_params[3], "r3", 32, PARAM_IN_OUT);
 
-	while (count > 0) {
-		uint32_t thisrun_count = (count > (buffer_size / 2)) ?
-			(buffer_size / 2) : count;
-
-		retval = target_write_buffer(target, source->address, thisrun_count * 2, buffer);
-		if (retval != ERROR_OK)
-			break;
-
-		buf_set_u32(reg_params[0].value, 0, 32, source->address);
-		buf_set_u32(reg_params[1].value, 0, 32, address);
-		buf_set_u32(reg_params[2].value, 0, 32, thisrun_count);
-		buf_set_u32(reg_params[3].value, 0, 32, 0);
-
-		retval = target_run_algorithm(target, 0, NULL, 4, reg_params,
-				write_algorithm->address, 0, 10000, &armv7m_info);
-		if (retval != ERROR_OK) {
-			LOG_ERROR("error executing em357 flash write algorithm");
-			break;
-		}
-
-		if (buf_get_u32(reg_params[3].value, 0, 32) & FLASH_PGERR) {
-			LOG_ERROR("flash memory not erased before writing");
-			/* Clear but report errors */
-			target_write_u32(target, EM357_FLASH_SR, FLASH_PGERR);
-			retval = ERROR_FAIL;
-			break;
-		}
-
-		if (buf_get_u32(reg_params[3].value, 0, 32) & FLASH_WRPRTERR) {
-			LOG_ERROR("flash memory write protected");
-			/* Clear but report errors */
-			target_write_u32(target, EM357_FLASH_SR, FLASH_WRPRTERR);
-			retval = ERROR_FAIL;
-			break;
-		}
-
-		buffer += thisrun_count * 2;
-		address += thisrun_count * 2;
-		count -= thisrun_count;
-	}
+	retval = target_run_flash_pingpong_algorithm(target, buffer, count, 2,
+			4, reg_params, source->address, buffer_size,
+			write_algorithm->address, 0, 10000, &armv7m_info,
+			&em357_write_block_ops, &address);
+	if (retval != ERROR_OK)
+		LOG_ERROR("error executing em357 flash write algorithm");
 
 	target_free_working_area(target, source);
 	target_free_working_area(target, write_algorithm);
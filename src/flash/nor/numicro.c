@@ -688,6 +688,21 @@ static const uint8_t numicro_m4_flash_write_code[] = {
 #include "../../../contrib/loaders/flash/numicro/numicro_m4.inc"
 };
 
+static int numicro_writeblock_prepare(struct target *target, void *priv,
+		uint32_t source, uint32_t offset, uint32_t count, struct reg_param *reg_params)
+{
+	uint32_t *address = priv;
+
+	buf_set_u32(reg_params[0].value, 0, 32, source);
+	buf_set_u32(reg_params[1].value, 0, 32, *address + offset);
+	buf_set_u32(reg_params[2].value, 0, 32, count);
+	return ERROR_OK;
+}
+
+static const struct target_pingpong_ops numicro_writeblock_ops = {
+	.prepare = numicro_writeblock_prepare,
+};
+
 /* Program LongWord Block Write */
 static int numicro_writeblock(struct flash_bank *bank, const uint8_t *buffer,
 		uint32_t offset, uint32_t count)
@@ -771,28 +786,13 @@ static int numicro_writeblock(struct flash_bank *bank, const uint8_t *buffer,
 
 	/* write code buffer and use Flash programming code within NuMicro     */
 	/* Set breakpoint to 0 with time-out of 1000 ms                        */
-	while (count > 0) {
-		uint32_t thisrun_count = (count > (buffer_size / 4)) ? (buffer_size / 4) : count;
-
-		retval = target_write_buffer(target, source->address, thisrun_count * 4, buffer);
-		if (retval != ERROR_OK)
-			break;
-
-		buf_set_u32(reg_params[0].value, 0, 32, source->address);
-		buf_set_u32(reg_params[1].value, 0, 32, address);
-		buf_set_u32(reg_params[2].value, 0, 32, thisrun_count);
-
-		retval = target_run_algorithm(target, 0, NULL, 3, reg_params,
-				write_algorithm->address, 0, 100000, &armv7m_info);
-		if (retval != ERROR_OK) {
-			LOG_ERROR("Error executing NuMicro Flash programming algorithm");
-			retval = ERROR_FLASH_OPERATION_FAILED;
-			break;
-		}
-
-		buffer  += thisrun_count * 4;
-		address += thisrun_count * 4;
-		count   -= thisrun_count;
+	retval = target_run_flash_pingpong_algorithm(target, buffer, count, 4,
+			3, reg_params, source->address, buffer_size,
+			write_algorithm->address, 0, 100000, &armv7m_info,
+			&numicro_writeblock_ops, &address);
+	if (retval != ERROR_OK) {
+		LOG_ERROR("Error executing NuMicro Flash programming algorithm");
+		retval = ERROR_FLASH_OPERATION_FAILED;
 	}
 
 	target_free_working_area(target, source);
@@ -129,27 +129,16 @@ void *buf_set_buf(const void *_src, unsigned src_start,
 	db = dst_start / 8;
 	sq = src_start % 8;
 	dq = dst_start % 8;
-	lb = len / 8;
-	lq = len % 8;
 
 	src += sb;
 	dst += db;
 
-	/* check if both buffers are on byte boundary and
-	 * len is a multiple of 8bit so we can simple copy
-	 * the buffer */
-	if ((sq == 0) && (dq == 0) &&  (lq == 0)) {
-		for (i = 0; i < lb; i++)
-			*dst++ = *src++;
-		return _dst;
-	}
-
-	/* fallback to slow bit copy */
-	for (i = 0; i < len; i++) {
-		if (((*src >> (sq&7)) & 1) == 1)
-			*dst |= 1 << (dq&7);
+	/* copy single bits until the destination is on a byte boundary */
+	while (dq && len) {
+		if (((*src >> sq) & 1) == 1)
+			*dst |= 1 << dq;
 		else
-			*dst &= ~(1 << (dq&7));
+			*dst &= ~(1 << dq);
 		if (sq++ == 7) {
 			sq = 0;
 			src++;
@@ -158,6 +147,41 @@ void *buf_set_buf(const void *_src, unsigned src_start,
 			dq = 0;
 			dst++;
 		}
+		len--;
+	}
+
+	lb = len / 8;
+	lq = len % 8;
+
+	if (sq == 0) {
+		/* both buffers are on a byte boundary */
+		memmove(dst, src, lb);
+	} else {
+		/* Every destination byte is made of the upper bits of one source
+		 * byte and the lower bits of the next one. Assemble 64 bits at a
+		 * time while enough whole bytes are left; the source bit at
+		 * offset 63 + sq lies in byte i + 8, which is still part of the
+		 * range being copied. */
+		i = 0;
+		for (; i + 8 <= lb; i += 8) {
+			uint64_t w = le_to_h_u64(src + i) >> sq;
+			w |= (uint64_t)src[i + 8] << (64 - sq);
+			h_u64_to_le(dst + i, w);
+		}
+		for (; i < lb; i++)
+			dst[i] = (src[i] >> sq) | (src[i + 1] << (8 - sq));
+	}
+
+	src += lb;
+	dst += lb;
+
+	/* remaining bits, the destination is byte aligned here */
+	if (lq) {
+		uint8_t mask = (1 << lq) - 1;
+		uint8_t bits = *src >> sq;
+		if (sq + lq > 8)
+			bits |= src[1] << (8 - sq);
+		*dst = (*dst & ~mask) | (bits & mask);
 	}
 
 	return _dst;
@@ -301,9 +325,28 @@ void bit_copy_queue_init(struct bit_copy_queue *q)
 	INIT_LIST_HEAD(&q->list);
 }
 
+/* check if bit offset a_offset of buffer a is the same bit as b_offset of b */
+static bool bit_copy_same_bit(const uint8_t *a, unsigned int a_offset,
+	const uint8_t *b, unsigned int b_offset)
+{
+	return a + a_offset / 8 == b + b_offset / 8 && a_offset % 8 == b_offset % 8;
+}
+
 int bit_copy_queued(struct bit_copy_queue *q, uint8_t *dst, unsigned dst_offset, const uint8_t *src,
 	unsigned src_offset, unsigned bit_count)
 {
+	/* extend the previous copy if this one continues it in both buffers,
+	 * so that bit_copy_execute() deals with fewer and longer runs */
+	if (!list_empty(&q->list)) {
+		struct bit_copy_queue_entry *last =
+			list_last_entry(&q->list, struct bit_copy_queue_entry, list);
+		if (bit_copy_same_bit(last->dst, last->dst_offset + last->bit_count, dst, dst_offset) &&
+				bit_copy_same_bit(last->src, last->src_offset + last->bit_count, src, src_offset)) {
+			last->bit_count += bit_count;
+			return ERROR_OK;
+		}
+	}
+
 	struct bit_copy_queue_entry *qe = malloc(sizeof(*qe));
 	if (!qe)
 		return ERROR_FAIL;
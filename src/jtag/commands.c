@@ -242,8 +242,13 @@ int jtag_read_buffer(uint8_t *buffer, const struct scan_command *cmd)
 		 */
 		if (cmd->fields[i].in_value) {
 			int num_bits = cmd->fields[i].num_bits;
-			uint8_t *captured = buf_set_buf(buffer, bit_count,
-					malloc(DIV_ROUND_UP(num_bits, 8)), 0, num_bits);
+			uint8_t *captured = cmd->fields[i].in_value;
+
+			/* copy straight into the field, clearing the unused bits
+			 * of the last byte like buf_cpy() does */
+			buf_set_buf(buffer, bit_count, captured, 0, num_bits);
+			if (num_bits % 8)
+				captured[num_bits / 8] &= (1 << (num_bits % 8)) - 1;
 
 			if (LOG_LEVEL_IS(LOG_LVL_DEBUG_IO)) {
 				char *char_buf = buf_to_hex_str(captured,
@@ -255,11 +260,6 @@ int jtag_read_buffer(uint8_t *buffer, const struct scan_command *cmd)
 						i, num_bits, char_buf);
 				free(char_buf);
 			}
-
-			if (cmd->fields[i].in_value)
-				buf_cpy(captured, cmd->fields[i].in_value, num_bits);
-
-			free(captured);
 		}
 		bit_count += cmd->fields[i].num_bits;
 	}
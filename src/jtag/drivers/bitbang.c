@@ -155,11 +155,24 @@ static int bitbang_runtest(int num_cycles)
 	}
 
 	/* execute num_cycles */
-	for (i = 0; i < num_cycles; i++) {
-		if (bitbang_interface->write(0, 0, 0) != ERROR_OK)
+	if (bitbang_interface->shift && num_cycles > 0) {
+		/* TMS and TDI stay low, one zeroed vector serves both */
+		uint8_t *zeros = calloc(1, DIV_ROUND_UP(num_cycles, 8));
+		if (!zeros) {
+			LOG_ERROR("Out of memory");
 			return ERROR_FAIL;
-		if (bitbang_interface->write(1, 0, 0) != ERROR_OK)
+		}
+		int retval = bitbang_interface->shift(zeros, zeros, NULL, num_cycles);
+		free(zeros);
+		if (retval != ERROR_OK)
 			return ERROR_FAIL;
+	} else {
+		for (i = 0; i < num_cycles; i++) {
+			if (bitbang_interface->write(0, 0, 0) != ERROR_OK)
+				return ERROR_FAIL;
+			if (bitbang_interface->write(1, 0, 0) != ERROR_OK)
+				return ERROR_FAIL;
+		}
 	}
 	if (bitbang_interface->write(CLOCK_IDLE(), 0, 0) != ERROR_OK)
 		return ERROR_FAIL;
@@ -189,24 +202,29 @@ static int bitbang_stableclocks(int num_cycles)
 	return ERROR_OK;
 }
 
-static int bitbang_scan(bool ir_scan, enum scan_type type, uint8_t *buffer,
-		unsigned scan_size)
+static int bitbang_scan_shift(enum scan_type type, uint8_t *buffer,
+		unsigned int scan_size)
 {
-	tap_state_t saved_end_state = tap_get_end_state();
-	unsigned bit_cnt;
+	/* TMS is only raised on the last bit, to leave the shift state */
+	uint8_t *tms = calloc(1, DIV_ROUND_UP(scan_size, 8));
+	if (!tms) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	buf_set_u32(tms, scan_size - 1, 1, 1);
 
-	if (!((!ir_scan &&
-			(tap_get_state() == TAP_DRSHIFT)) ||
-			(ir_scan && (tap_get_state() == TAP_IRSHIFT)))) {
-		if (ir_scan)
-			bitbang_end_state(TAP_IRSHIFT);
-		else
-			bitbang_end_state(TAP_DRSHIFT);
+	/* jtag_build_buffer() zero-fills the buffer, so TDI is low on SCAN_IN */
+	int retval = bitbang_interface->shift(tms, buffer,
+			type != SCAN_OUT ? buffer : NULL, scan_size);
+	free(tms);
 
-		if (bitbang_state_move(0) != ERROR_OK)
-			return ERROR_FAIL;
-		bitbang_end_state(saved_end_state);
-	}
+	return retval;
+}
+
+static int bitbang_scan_bits(enum scan_type type, uint8_t *buffer,
+		unsigned int scan_size)
+{
+	unsigned int bit_cnt;
 
 	size_t buffered = 0;
 	for (bit_cnt = 0; bit_cnt < scan_size; bit_cnt++) {
@@ -267,6 +285,35 @@ static int bitbang_scan(bool ir_scan, enum scan_type type, uint8_t *buffer,
 		}
 	}
 
+	return ERROR_OK;
+}
+
+static int bitbang_scan(bool ir_scan, enum scan_type type, uint8_t *buffer,
+		unsigned int scan_size)
+{
+	tap_state_t saved_end_state = tap_get_end_state();
+	int retval;
+
+	if (!((!ir_scan &&
+			(tap_get_state() == TAP_DRSHIFT)) ||
+			(ir_scan && (tap_get_state() == TAP_IRSHIFT)))) {
+		if (ir_scan)
+			bitbang_end_state(TAP_IRSHIFT);
+		else
+			bitbang_end_state(TAP_DRSHIFT);
+
+		if (bitbang_state_move(0) != ERROR_OK)
+			return ERROR_FAIL;
+		bitbang_end_state(saved_end_state);
+	}
+
+	if (bitbang_interface->shift && scan_size > 0)
+		retval = bitbang_scan_shift(type, buffer, scan_size);
+	else
+		retval = bitbang_scan_bits(type, buffer, scan_size);
+	if (retval != ERROR_OK)
+		return ERROR_FAIL;
+
 	if (tap_get_state() != tap_get_end_state()) {
 		/* we *KNOW* the above loop transitioned out of
 		 * the shift state, so we skip the first state
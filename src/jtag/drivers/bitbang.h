@@ -46,6 +46,14 @@ struct bitbang_interface {
 	/** Blink led (optional). */
 	int (*blink)(int on);
 
+	/** Clock a run of bits in one transfer (optional).
+	 *
+	 * For each bit, TCK is driven low with TMS and TDI taken from the
+	 * LSB-first vectors, TDO is sampled into @a tdo (if not NULL), then TCK
+	 * is driven high. @a tdi and @a tdo may point to the same buffer. */
+	int (*shift)(const uint8_t *tms, const uint8_t *tdi, uint8_t *tdo,
+			unsigned int num_bits);
+
 	/** Sample SWDIO and return the value. */
 	int (*swdio_read)(void);
 
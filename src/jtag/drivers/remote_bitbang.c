@@ -22,9 +22,15 @@
 /* arbitrary limit on host name length: */
 #define REMOTE_BITBANG_HOST_MAX 255
 
+/* limit of bits in a single shift frame, so remote ends can use static buffers */
+#define REMOTE_BITBANG_FRAME_MAX_BITS 8192
+
 static char *remote_bitbang_host;
 static char *remote_bitbang_port;
 
+/* try to negotiate the shift frame extension at init */
+static bool remote_bitbang_batch = true;
+
 static int remote_bitbang_fd;
 static uint8_t remote_bitbang_send_buf[512];
 static unsigned int remote_bitbang_send_buf_used;
@@ -148,6 +154,42 @@ static int remote_bitbang_queue(int c, flush_bool_t flush)
 	return ERROR_OK;
 }
 
+static int remote_bitbang_queue_buf(const uint8_t *buf, size_t len)
+{
+	while (len > 0) {
+		size_t chunk = MIN(len, ARRAY_SIZE(remote_bitbang_send_buf) -
+				remote_bitbang_send_buf_used);
+		memcpy(remote_bitbang_send_buf + remote_bitbang_send_buf_used, buf, chunk);
+		remote_bitbang_send_buf_used += chunk;
+		buf += chunk;
+		len -= chunk;
+		if (remote_bitbang_send_buf_used >= ARRAY_SIZE(remote_bitbang_send_buf) &&
+				remote_bitbang_flush() != ERROR_OK)
+			return ERROR_FAIL;
+	}
+	return ERROR_OK;
+}
+
+/* Read len bytes from the remote end, blocking until all of them arrived. */
+static int remote_bitbang_read_bytes(uint8_t *buf, size_t len)
+{
+	while (len > 0) {
+		if (remote_bitbang_recv_buf_empty()) {
+			if (remote_bitbang_fill_buf(BLOCK) != ERROR_OK)
+				return ERROR_FAIL;
+			if (remote_bitbang_recv_buf_empty()) {
+				LOG_ERROR("remote_bitbang: connection closed by remote end");
+				return ERROR_FAIL;
+			}
+		}
+		*buf++ = remote_bitbang_recv_buf[remote_bitbang_recv_buf_start];
+		remote_bitbang_recv_buf_start =
+			(remote_bitbang_recv_buf_start + 1) % sizeof(remote_bitbang_recv_buf);
+		len--;
+	}
+	return ERROR_OK;
+}
+
 static int remote_bitbang_quit(void)
 {
 	if (remote_bitbang_queue('Q', FLUSH_SEND_BUF) == ERROR_FAIL)
@@ -220,6 +262,44 @@ static int remote_bitbang_blink(int on)
 	return remote_bitbang_queue(c, FLUSH_SEND_BUF);
 }
 
+static int remote_bitbang_shift(const uint8_t *tms, const uint8_t *tdi,
+		uint8_t *tdo, unsigned int num_bits)
+{
+	uint8_t vec[DIV_ROUND_UP(REMOTE_BITBANG_FRAME_MAX_BITS, 8)];
+
+	for (unsigned int offset = 0; offset < num_bits; ) {
+		unsigned int count = MIN(num_bits - offset, REMOTE_BITBANG_FRAME_MAX_BITS);
+		unsigned int bytes = DIV_ROUND_UP(count, 8);
+		uint8_t header[3];
+
+		header[0] = tdo ? 'T' : 'S';
+		h_u16_to_le(header + 1, count);
+		if (remote_bitbang_queue_buf(header, sizeof(header)) != ERROR_OK)
+			return ERROR_FAIL;
+
+		memset(vec, 0, bytes);
+		buf_set_buf(tms, offset, vec, 0, count);
+		if (remote_bitbang_queue_buf(vec, bytes) != ERROR_OK)
+			return ERROR_FAIL;
+
+		memset(vec, 0, bytes);
+		buf_set_buf(tdi, offset, vec, 0, count);
+		if (remote_bitbang_queue_buf(vec, bytes) != ERROR_OK)
+			return ERROR_FAIL;
+
+		if (tdo) {
+			/* tdi and tdo may alias, tdi bits of this frame are already queued */
+			if (remote_bitbang_read_bytes(vec, bytes) != ERROR_OK)
+				return ERROR_FAIL;
+			buf_set_buf(vec, 0, tdo, offset, count);
+		}
+
+		offset += count;
+	}
+
+	return ERROR_OK;
+}
+
 static struct bitbang_interface remote_bitbang_bitbang = {
 	.buf_size = sizeof(remote_bitbang_recv_buf) - 1,
 	.sample = &remote_bitbang_sample,
@@ -228,6 +308,36 @@ static struct bitbang_interface remote_bitbang_bitbang = {
 	.blink = &remote_bitbang_blink,
 };
 
+/* Ask the remote end for the shift frame extension. A classic server ignores
+ * the 'X' query and only answers the trailing read request. */
+static int remote_bitbang_negotiate(void)
+{
+	uint8_t reply;
+
+	if (remote_bitbang_queue('X', NO_FLUSH) != ERROR_OK ||
+			remote_bitbang_queue('R', FLUSH_SEND_BUF) != ERROR_OK)
+		return ERROR_FAIL;
+
+	if (remote_bitbang_read_bytes(&reply, 1) != ERROR_OK)
+		return ERROR_FAIL;
+
+	if (reply == 'x') {
+		remote_bitbang_bitbang.shift = &remote_bitbang_shift;
+		if (remote_bitbang_read_bytes(&reply, 1) != ERROR_OK)
+			return ERROR_FAIL;
+	}
+
+	if (reply != '0' && reply != '1') {
+		LOG_ERROR("remote_bitbang: invalid negotiation response: %c(%i)",
+				reply, reply);
+		return ERROR_FAIL;
+	}
+
+	LOG_INFO("remote_bitbang: %s protocol",
+			remote_bitbang_bitbang.shift ? "shift frame" : "classic");
+	return ERROR_OK;
+}
+
 static int remote_bitbang_init_tcp(void)
 {
 	struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM };
@@ -323,6 +433,10 @@ static int remote_bitbang_init(void)
 
 	socket_nonblock(remote_bitbang_fd);
 
+	remote_bitbang_bitbang.shift = NULL;
+	if (remote_bitbang_batch && remote_bitbang_negotiate() != ERROR_OK)
+		return ERROR_FAIL;
+
 	LOG_INFO("remote_bitbang driver initialized");
 	return ERROR_OK;
 }
@@ -349,6 +463,15 @@ COMMAND_HANDLER(remote_bitbang_handle_remote_bitbang_host_command)
 	return ERROR_COMMAND_SYNTAX_ERROR;
 }
 
+COMMAND_HANDLER(remote_bitbang_handle_remote_bitbang_batch_command)
+{
+	if (CMD_ARGC != 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	COMMAND_PARSE_ON_OFF(CMD_ARGV[0], remote_bitbang_batch);
+	return ERROR_OK;
+}
+
 static const struct command_registration remote_bitbang_subcommand_handlers[] = {
 	{
 		.name = "port",
@@ -366,6 +489,14 @@ static const struct command_registration remote_bitbang_subcommand_handlers[] =
 			"  if port is 0 or unset, this is the name of the unix socket to use.",
 		.usage = "host_name",
 	},
+	{
+		.name = "batch",
+		.handler = remote_bitbang_handle_remote_bitbang_batch_command,
+		.mode = COMMAND_CONFIG,
+		.help = "Negotiate the binary shift frame extension with the remote jtag.\n"
+			"  if off, only the classic one-character-per-edge protocol is used.",
+		.usage = "(on|off)",
+	},
 	COMMAND_REGISTRATION_DONE,
 };
 
@@ -27,6 +27,7 @@
 #include <target/arm_cti.h>
 #include <target/arm_adi_v5.h>
 #include <target/arm_tpiu_swo.h>
+#include <target/armv7m_trace.h>
 #include <rtt/rtt.h>
 
 #include <server/server.h>
@@ -354,6 +355,7 @@ int openocd_main(int argc, char *argv[])
 	flash_free_all_banks();
 	gdb_service_free();
 	arm_tpiu_swo_cleanup_all();
+	itm_decode_cleanup_all();
 	server_free();
 
 	unregister_all_commands(cmd_ctx, NULL);
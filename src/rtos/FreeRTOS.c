@@ -73,8 +73,23 @@ static const struct freertos_params freertos_params_list[] = {
 	},
 };
 
+struct freertos {
+	const struct freertos_params *params;
+	/** uxTaskNumber at the last thread list update */
+	uint32_t task_number;
+	bool task_number_valid;
+};
+
+static const struct freertos_params *freertos_params(const struct rtos *rtos)
+{
+	const struct freertos *freertos = rtos->rtos_specific_params;
+
+	return freertos->params;
+}
+
 static bool freertos_detect_rtos(struct target *target);
 static int freertos_create(struct target *target);
+static void freertos_free_driver_priv(struct rtos *rtos);
 static int freertos_update_threads(struct rtos *rtos);
 static int freertos_get_thread_reg_list(struct rtos *rtos, int64_t thread_id,
 		struct rtos_reg **reg_list, int *num_regs);
@@ -88,6 +103,7 @@ const struct rtos_type freertos_rtos = {
 	.update_threads = freertos_update_threads,
 	.get_thread_reg_list = freertos_get_thread_reg_list,
 	.get_symbol_list_to_lookup = freertos_get_symbol_list_to_lookup,
+	.free_driver_priv = freertos_free_driver_priv,
 };
 
 enum freertos_symbol_values {
@@ -103,6 +119,7 @@ enum freertos_symbol_values {
 	FREERTOS_VAL_UX_CURRENT_NUMBER_OF_TASKS = 9,
 	FREERTOS_VAL_UX_TOP_USED_PRIORITY = 10,
 	FREERTOS_VAL_X_SCHEDULER_RUNNING = 11,
+	FREERTOS_VAL_UX_TASK_NUMBER = 12,
 };
 
 struct symbols {
@@ -123,24 +140,83 @@ static const struct symbols freertos_symbol_list[] = {
 	{ "uxCurrentNumberOfTasks", false },
 	{ "uxTopUsedPriority", true }, /* Unavailable since v7.5.3 */
 	{ "xSchedulerRunning", false },
+	{ "uxTaskNumber", true }, /* Only used to keep thread names across updates */
 	{ NULL, false }
 };
 
-/* TODO: */
-/* this is not safe for little endian yet */
-/* may be problems reading if sizes are not 32 bit long integers. */
-/* test mallocs for failure */
+#define FREERTOS_THREAD_NAME_STR_SIZE (200)
+
+/* Read the name of a thread, or take it from the previous update. */
+static char *freertos_thread_name(struct rtos *rtos, threadid_t threadid,
+		struct thread_detail *old_details, int old_count)
+{
+	const struct freertos_params *param = freertos_params(rtos);
+	char tmp_str[FREERTOS_THREAD_NAME_STR_SIZE];
+	char *name;
+
+	name = rtos_take_thread_name(old_details, old_count, threadid);
+	if (name)
+		return name;
+
+	int retval = target_read_buffer(rtos->target,
+			threadid + param->thread_name_offset,
+			FREERTOS_THREAD_NAME_STR_SIZE,
+			(uint8_t *)&tmp_str);
+	if (retval != ERROR_OK) {
+		LOG_ERROR("Error reading thread name in FreeRTOS thread list");
+		return NULL;
+	}
+	tmp_str[FREERTOS_THREAD_NAME_STR_SIZE - 1] = '\x00';
+	LOG_DEBUG("FreeRTOS: Read Thread Name at 0x%" PRIx64 ", value '%s'",
+			threadid + param->thread_name_offset, tmp_str);
+
+	if (tmp_str[0] == '\x00')
+		strcpy(tmp_str, "No Name");
+
+	name = strdup(tmp_str);
+	if (!name)
+		LOG_ERROR("Out of memory");
+
+	return name;
+}
+
+/*
+ * Thread names are kept across updates as long as uxTaskNumber, which is
+ * incremented whenever a task is created, does not change. A TCB freed by
+ * vTaskDelete() and reused by a new task therefore never shows a stale name.
+ */
+static bool freertos_thread_names_valid(struct rtos *rtos)
+{
+	struct freertos *freertos = rtos->rtos_specific_params;
+	symbol_address_t address = rtos->symbols[FREERTOS_VAL_UX_TASK_NUMBER].address;
+	uint32_t task_number;
+	bool valid;
+
+	if (!address)
+		return false;
+
+	if (target_read_u32(rtos->target, address, &task_number) != ERROR_OK)
+		return false;
+
+	valid = freertos->task_number_valid && freertos->task_number == task_number;
+	freertos->task_number = task_number;
+	freertos->task_number_valid = true;
+
+	return valid;
+}
 
 static int freertos_update_threads(struct rtos *rtos)
 {
 	int retval;
 	unsigned int tasks_found = 0;
 	const struct freertos_params *param;
+	struct thread_detail *old_details;
+	int old_count;
 
 	if (!rtos->rtos_specific_params)
 		return -1;
 
-	param = (const struct freertos_params *) rtos->rtos_specific_params;
+	param = freertos_params(rtos);
 
 	if (!rtos->symbols) {
 		LOG_ERROR("No symbols for FreeRTOS");
@@ -165,8 +241,8 @@ static int freertos_update_threads(struct rtos *rtos)
 		return retval;
 	}
 
-	/* wipe out previous thread details if any */
-	rtos_free_threadlist(rtos);
+	/* keep previous thread details, unchanged threads reuse their names */
+	rtos_detach_threadlist(rtos, &old_details, &old_count);
 
 	/* read the current thread */
 	uint32_t pointer_casts_are_bad;
@@ -175,7 +251,7 @@ static int freertos_update_threads(struct rtos *rtos)
 			&pointer_casts_are_bad);
 	if (retval != ERROR_OK) {
 		LOG_ERROR("Error reading current thread in FreeRTOS thread list");
-		return retval;
+		goto out;
 	}
 	rtos->current_thread = pointer_casts_are_bad;
 	LOG_DEBUG("FreeRTOS: Read pxCurrentTCB at 0x%" PRIx64 ", value 0x%" PRIx64,
@@ -189,7 +265,7 @@ static int freertos_update_threads(struct rtos *rtos)
 			&scheduler_running);
 	if (retval != ERROR_OK) {
 		LOG_ERROR("Error reading FreeRTOS scheduler state");
-		return retval;
+		goto out;
 	}
 	LOG_DEBUG("FreeRTOS: Read xSchedulerRunning at 0x%" PRIx64 ", value 0x%" PRIx32,
 										rtos->symbols[FREERTOS_VAL_X_SCHEDULER_RUNNING].address,
@@ -206,7 +282,8 @@ static int freertos_update_threads(struct rtos *rtos)
 				sizeof(struct thread_detail) * thread_list_size);
 		if (!rtos->thread_details) {
 			LOG_ERROR("Error allocating memory for %d threads", thread_list_size);
-			return ERROR_FAIL;
+			retval = ERROR_FAIL;
+			goto out;
 		}
 		rtos->current_thread = 1;
 		rtos->thread_details->threadid = rtos->current_thread;
@@ -214,10 +291,11 @@ static int freertos_update_threads(struct rtos *rtos)
 		rtos->thread_details->extra_info_str = NULL;
 		rtos->thread_details->thread_name_str = malloc(sizeof(tmp_str));
 		strcpy(rtos->thread_details->thread_name_str, tmp_str);
+		rtos->thread_count = 1;
 
 		if (thread_list_size == 1) {
-			rtos->thread_count = 1;
-			return ERROR_OK;
+			retval = ERROR_OK;
+			goto out;
 		}
 	} else {
 		/* create space for new thread details */
@@ -225,28 +303,37 @@ static int freertos_update_threads(struct rtos *rtos)
 				sizeof(struct thread_detail) * thread_list_size);
 		if (!rtos->thread_details) {
 			LOG_ERROR("Error allocating memory for %d threads", thread_list_size);
-			return ERROR_FAIL;
+			retval = ERROR_FAIL;
+			goto out;
 		}
 	}
 
 	/* Find out how many lists are needed to be read from pxReadyTasksLists, */
 	if (rtos->symbols[FREERTOS_VAL_UX_TOP_USED_PRIORITY].address == 0) {
 		LOG_ERROR("FreeRTOS: uxTopUsedPriority is not defined, consult the OpenOCD manual for a work-around");
-		return ERROR_FAIL;
+		retval = ERROR_FAIL;
+		goto out;
 	}
 	uint32_t top_used_priority = 0;
 	retval = target_read_u32(rtos->target,
 			rtos->symbols[FREERTOS_VAL_UX_TOP_USED_PRIORITY].address,
 			&top_used_priority);
 	if (retval != ERROR_OK)
-		return retval;
+		goto out;
 	LOG_DEBUG("FreeRTOS: Read uxTopUsedPriority at 0x%" PRIx64 ", value %" PRIu32,
 										rtos->symbols[FREERTOS_VAL_UX_TOP_USED_PRIORITY].address,
 										top_used_priority);
 	if (top_used_priority > FREERTOS_MAX_PRIORITIES) {
 		LOG_ERROR("FreeRTOS top used priority is unreasonably big, not proceeding: %" PRIu32,
 			top_used_priority);
-		return ERROR_FAIL;
+		retval = ERROR_FAIL;
+		goto out;
+	}
+
+	if (!freertos_thread_names_valid(rtos)) {
+		rtos_free_thread_details(old_details, old_count);
+		old_details = NULL;
+		old_count = 0;
 	}
 
 	/* uxTopUsedPriority was defined as configMAX_PRIORITIES - 1
@@ -256,134 +343,121 @@ static int freertos_update_threads(struct rtos *rtos)
 	 * Here we restore the original configMAX_PRIORITIES value */
 	unsigned int config_max_priorities = top_used_priority + 1;
 
-	symbol_address_t *list_of_lists =
-		malloc(sizeof(symbol_address_t) * (config_max_priorities + 5));
-	if (!list_of_lists) {
+	const symbol_address_t other_lists[] = {
+		rtos->symbols[FREERTOS_VAL_X_DELAYED_TASK_LIST1].address,
+		rtos->symbols[FREERTOS_VAL_X_DELAYED_TASK_LIST2].address,
+		rtos->symbols[FREERTOS_VAL_X_PENDING_READY_LIST].address,
+		rtos->symbols[FREERTOS_VAL_X_SUSPENDED_TASK_LIST].address,
+		rtos->symbols[FREERTOS_VAL_X_TASKS_WAITING_TERMINATION].address,
+	};
+	unsigned int num_lists = config_max_priorities + ARRAY_SIZE(other_lists);
+
+	/* copies of all list headers, the ready lists are read with a single access */
+	uint8_t *lists = calloc(num_lists, param->list_width);
+	if (!lists) {
 		LOG_ERROR("Error allocating memory for %u priorities", config_max_priorities);
-		return ERROR_FAIL;
+		retval = ERROR_FAIL;
+		goto out;
 	}
 
-	unsigned int num_lists;
-	for (num_lists = 0; num_lists < config_max_priorities; num_lists++)
-		list_of_lists[num_lists] = rtos->symbols[FREERTOS_VAL_PX_READY_TASKS_LISTS].address +
-			num_lists * param->list_width;
-
-	list_of_lists[num_lists++] = rtos->symbols[FREERTOS_VAL_X_DELAYED_TASK_LIST1].address;
-	list_of_lists[num_lists++] = rtos->symbols[FREERTOS_VAL_X_DELAYED_TASK_LIST2].address;
-	list_of_lists[num_lists++] = rtos->symbols[FREERTOS_VAL_X_PENDING_READY_LIST].address;
-	list_of_lists[num_lists++] = rtos->symbols[FREERTOS_VAL_X_SUSPENDED_TASK_LIST].address;
-	list_of_lists[num_lists++] = rtos->symbols[FREERTOS_VAL_X_TASKS_WAITING_TERMINATION].address;
+	retval = target_read_buffer(rtos->target,
+			rtos->symbols[FREERTOS_VAL_PX_READY_TASKS_LISTS].address,
+			config_max_priorities * param->list_width, lists);
+	if (retval != ERROR_OK) {
+		LOG_ERROR("Error reading FreeRTOS ready task lists");
+		goto out_free_lists;
+	}
 
-	for (unsigned int i = 0; i < num_lists; i++) {
-		if (list_of_lists[i] == 0)
+	for (unsigned int i = 0; i < ARRAY_SIZE(other_lists); i++) {
+		/* optional lists stay empty */
+		if (other_lists[i] == 0)
 			continue;
 
-		/* Read the number of threads in this list */
-		uint32_t list_thread_count = 0;
-		retval = target_read_u32(rtos->target,
-				list_of_lists[i],
-				&list_thread_count);
+		retval = target_read_buffer(rtos->target, other_lists[i], param->list_width,
+				lists + (config_max_priorities + i) * param->list_width);
 		if (retval != ERROR_OK) {
-			LOG_ERROR("Error reading number of threads in FreeRTOS thread list");
-			free(list_of_lists);
-			return retval;
+			LOG_ERROR("Error reading FreeRTOS thread list");
+			goto out_free_lists;
 		}
-		LOG_DEBUG("FreeRTOS: Read thread count for list %u at 0x%" PRIx64 ", value %" PRIu32,
-										i, list_of_lists[i], list_thread_count);
+	}
+
+	/* next and content pointers of a list item are read with a single access */
+	const unsigned int list_elem_size = MAX(param->list_elem_next_offset,
+			param->list_elem_content_offset) + param->pointer_width;
+	uint8_t list_elem[UINT8_MAX + sizeof(uint32_t)];
+
+	for (unsigned int i = 0; i < num_lists; i++) {
+		const uint8_t *list = lists + i * param->list_width;
+
+		/* Read the number of threads in this list */
+		uint32_t list_thread_count = target_buffer_get_u32(rtos->target, list);
+		LOG_DEBUG("FreeRTOS: Thread count for list %u, value %" PRIu32,
+										i, list_thread_count);
 
 		if (list_thread_count == 0)
 			continue;
 
 		/* Read the location of first list item */
 		uint32_t prev_list_elem_ptr = -1;
-		uint32_t list_elem_ptr = 0;
-		retval = target_read_u32(rtos->target,
-				list_of_lists[i] + param->list_next_offset,
-				&list_elem_ptr);
-		if (retval != ERROR_OK) {
-			LOG_ERROR("Error reading first thread item location in FreeRTOS thread list");
-			free(list_of_lists);
-			return retval;
-		}
-		LOG_DEBUG("FreeRTOS: Read first item for list %u at 0x%" PRIx64 ", value 0x%" PRIx32,
-										i, list_of_lists[i] + param->list_next_offset, list_elem_ptr);
+		uint32_t list_elem_ptr = target_buffer_get_u32(rtos->target,
+				list + param->list_next_offset);
+		LOG_DEBUG("FreeRTOS: First item for list %u, value 0x%" PRIx32,
+										i, list_elem_ptr);
 
 		while ((list_thread_count > 0) && (list_elem_ptr != 0) &&
 				(list_elem_ptr != prev_list_elem_ptr) &&
 				(tasks_found < thread_list_size)) {
-			/* Get the location of the thread structure. */
-			retval = target_read_u32(rtos->target,
-					list_elem_ptr + param->list_elem_content_offset,
-					&pointer_casts_are_bad);
+			retval = target_read_buffer(rtos->target, list_elem_ptr,
+					list_elem_size, list_elem);
 			if (retval != ERROR_OK) {
-				LOG_ERROR("Error reading thread list item object in FreeRTOS thread list");
-				free(list_of_lists);
-				return retval;
+				LOG_ERROR("Error reading thread list item in FreeRTOS thread list");
+				goto out_free_lists;
 			}
-			rtos->thread_details[tasks_found].threadid = pointer_casts_are_bad;
+
+			/* Get the location of the thread structure. */
+			struct thread_detail *detail = &rtos->thread_details[tasks_found];
+			detail->threadid = target_buffer_get_u32(rtos->target,
+					list_elem + param->list_elem_content_offset);
 			LOG_DEBUG("FreeRTOS: Read Thread ID at 0x%" PRIx32 ", value 0x%" PRIx64,
 										list_elem_ptr + param->list_elem_content_offset,
-										rtos->thread_details[tasks_found].threadid);
-
-			/* get thread name */
+										detail->threadid);
 
-			#define FREERTOS_THREAD_NAME_STR_SIZE (200)
-			char tmp_str[FREERTOS_THREAD_NAME_STR_SIZE];
-
-			/* Read the thread name */
-			retval = target_read_buffer(rtos->target,
-					rtos->thread_details[tasks_found].threadid + param->thread_name_offset,
-					FREERTOS_THREAD_NAME_STR_SIZE,
-					(uint8_t *)&tmp_str);
-			if (retval != ERROR_OK) {
-				LOG_ERROR("Error reading first thread item location in FreeRTOS thread list");
-				free(list_of_lists);
-				return retval;
+			detail->thread_name_str = freertos_thread_name(rtos, detail->threadid,
+					old_details, old_count);
+			if (!detail->thread_name_str) {
+				retval = ERROR_FAIL;
+				goto out_free_lists;
 			}
-			tmp_str[FREERTOS_THREAD_NAME_STR_SIZE-1] = '\x00';
-			LOG_DEBUG("FreeRTOS: Read Thread Name at 0x%" PRIx64 ", value '%s'",
-										rtos->thread_details[tasks_found].threadid + param->thread_name_offset,
-										tmp_str);
+			detail->exists = true;
 
-			if (tmp_str[0] == '\x00')
-				strcpy(tmp_str, "No Name");
-
-			rtos->thread_details[tasks_found].thread_name_str =
-				malloc(strlen(tmp_str)+1);
-			strcpy(rtos->thread_details[tasks_found].thread_name_str, tmp_str);
-			rtos->thread_details[tasks_found].exists = true;
-
-			if (rtos->thread_details[tasks_found].threadid == rtos->current_thread) {
+			if (detail->threadid == rtos->current_thread) {
 				char running_str[] = "State: Running";
-				rtos->thread_details[tasks_found].extra_info_str = malloc(
-						sizeof(running_str));
-				strcpy(rtos->thread_details[tasks_found].extra_info_str,
-					running_str);
-			} else
-				rtos->thread_details[tasks_found].extra_info_str = NULL;
+				detail->extra_info_str = malloc(sizeof(running_str));
+				strcpy(detail->extra_info_str, running_str);
+			} else {
+				detail->extra_info_str = NULL;
+			}
 
 			tasks_found++;
 			list_thread_count--;
 			rtos->thread_count = tasks_found;
 
 			prev_list_elem_ptr = list_elem_ptr;
-			list_elem_ptr = 0;
-			retval = target_read_u32(rtos->target,
-					prev_list_elem_ptr + param->list_elem_next_offset,
-					&list_elem_ptr);
-			if (retval != ERROR_OK) {
-				LOG_ERROR("Error reading next thread item location in FreeRTOS thread list");
-				free(list_of_lists);
-				return retval;
-			}
+			list_elem_ptr = target_buffer_get_u32(rtos->target,
+					list_elem + param->list_elem_next_offset);
 			LOG_DEBUG("FreeRTOS: Read next thread location at 0x%" PRIx32 ", value 0x%" PRIx32,
 										prev_list_elem_ptr + param->list_elem_next_offset,
 										list_elem_ptr);
 		}
 	}
 
-	free(list_of_lists);
-	return 0;
+	retval = ERROR_OK;
+
+out_free_lists:
+	free(lists);
+out:
+	rtos_free_thread_details(old_details, old_count);
+	return retval;
 }
 
 static int freertos_get_thread_reg_list(struct rtos *rtos, int64_t thread_id,
@@ -402,7 +476,7 @@ static int freertos_get_thread_reg_list(struct rtos *rtos, int64_t thread_id,
 	if (!rtos->rtos_specific_params)
 		return -1;
 
-	param = (const struct freertos_params *) rtos->rtos_specific_params;
+	param = freertos_params(rtos);
 
 	/* Read the stack pointer */
 	uint32_t pointer_casts_are_bad;
@@ -494,7 +568,7 @@ static int freertos_get_thread_ascii_info(struct rtos *rtos, threadid_t thread_i
 	if (!rtos->rtos_specific_params)
 		return -3;
 
-	param = (const struct freertos_params *) rtos->rtos_specific_params;
+	param = freertos_params(rtos);
 
 #define FREERTOS_THREAD_NAME_STR_SIZE (200)
 	char tmp_str[FREERTOS_THREAD_NAME_STR_SIZE];
@@ -534,10 +608,22 @@ static int freertos_create(struct target *target)
 {
 	for (unsigned int i = 0; i < ARRAY_SIZE(freertos_params_list); i++)
 		if (strcmp(freertos_params_list[i].target_name, target->type->name) == 0) {
-			target->rtos->rtos_specific_params = (void *)&freertos_params_list[i];
+			struct freertos *freertos = calloc(1, sizeof(*freertos));
+			if (!freertos) {
+				LOG_ERROR("Out of memory");
+				return -1;
+			}
+			freertos->params = &freertos_params_list[i];
+			target->rtos->rtos_specific_params = freertos;
 			return 0;
 		}
 
 	LOG_ERROR("Could not find target in FreeRTOS compatibility list");
 	return -1;
 }
+
+static void freertos_free_driver_priv(struct rtos *rtos)
+{
+	free(rtos->rtos_specific_params);
+	rtos->rtos_specific_params = NULL;
+}
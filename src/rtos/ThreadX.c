@@ -347,6 +347,13 @@ static int threadx_update_threads(struct rtos *rtos)
 		return retval;
 	}
 
+	/* name pointer, state and next pointer are read with a single access */
+	const unsigned int tcb_start = MIN(MIN(param->thread_name_offset,
+			param->thread_state_offset), param->thread_next_offset);
+	const unsigned int tcb_end = MAX(MAX(param->thread_name_offset + param->pointer_width,
+			param->thread_state_offset + 4), param->thread_next_offset + param->pointer_width);
+	uint8_t tcb[2 * UINT8_MAX + 8];
+
 	/* loop over all threads */
 	int64_t prev_thread_ptr = 0;
 	while ((thread_ptr != prev_thread_ptr) && (tasks_found < thread_list_size)) {
@@ -359,16 +366,17 @@ static int threadx_update_threads(struct rtos *rtos)
 		/* Save the thread pointer */
 		rtos->thread_details[tasks_found].threadid = thread_ptr;
 
-		/* read the name pointer */
-		retval = target_read_buffer(rtos->target,
-				thread_ptr + param->thread_name_offset,
-				param->pointer_width,
-				(uint8_t *)&name_ptr);
+		retval = target_read_buffer(rtos->target, thread_ptr + tcb_start,
+				tcb_end - tcb_start, tcb);
 		if (retval != ERROR_OK) {
-			LOG_ERROR("Could not read ThreadX thread name pointer from target");
+			LOG_ERROR("Could not read ThreadX thread control block from target");
 			return retval;
 		}
 
+		/* read the name pointer */
+		memcpy(&name_ptr, tcb + param->thread_name_offset - tcb_start,
+				param->pointer_width);
+
 		/* Read the thread name */
 		tmp_str[0] = '\x00';
 
@@ -395,14 +403,7 @@ static int threadx_update_threads(struct rtos *rtos)
 
 		/* Read the thread status */
 		int64_t thread_status = 0;
-		retval = target_read_buffer(rtos->target,
-				thread_ptr + param->thread_state_offset,
-				4,
-				(uint8_t *)&thread_status);
-		if (retval != ERROR_OK) {
-			LOG_ERROR("Error reading thread state from ThreadX target");
-			return retval;
-		}
+		memcpy(&thread_status, tcb + param->thread_state_offset - tcb_start, 4);
 
 		for (i = 0; (i < THREADX_NUM_STATES) &&
 				(threadx_thread_states[i].value != thread_status); i++) {
@@ -426,14 +427,8 @@ static int threadx_update_threads(struct rtos *rtos)
 
 		/* Get the location of the next thread structure. */
 		thread_ptr = 0;
-		retval = target_read_buffer(rtos->target,
-				prev_thread_ptr + param->thread_next_offset,
-				param->pointer_width,
-				(uint8_t *) &thread_ptr);
-		if (retval != ERROR_OK) {
-			LOG_ERROR("Error reading next thread pointer in ThreadX thread list");
-			return retval;
-		}
+		memcpy(&thread_ptr, tcb + param->thread_next_offset - tcb_start,
+				param->pointer_width);
 	}
 
 	rtos->thread_count = tasks_found;
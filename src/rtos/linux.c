@@ -127,10 +127,13 @@ static int linux_read_memory(struct target *target,
 		LOG_ERROR("linux awareness : address in user space");
 		return ERROR_FAIL;
 	}
+	int retval = target_read_memory(target, address, size, count, buffer);
 #ifdef PHYS
-	target_read_phys_memory(target, pa, size, count, buffer);
+	/*  the virtual access wins when both succeed, only fall back to the
+	 *  physical one when it fails */
+	if (retval != ERROR_OK)
+		target_read_phys_memory(target, pa, size, count, buffer);
 #endif
-	target_read_memory(target, address, size, count, buffer);
 	return ERROR_OK;
 }
 
@@ -280,56 +283,59 @@ int fill_task_pid(struct target *target, struct threads *t)
 }
 #endif
 
-static int fill_task(struct target *target, struct threads *t)
-{
-	int retval;
-	uint32_t pid_addr = t->base_addr + PID;
-	uint32_t mem_addr = t->base_addr + MEM;
-	uint32_t on_cpu = t->base_addr + ONCPU;
-	uint8_t *buffer = calloc(1, 4);
-	retval = fill_buffer(target, t->base_addr, buffer);
+/*  task_struct members read by fill_task(), from the state (offset 0) up
+ *  to the end of comm, so that a new task costs a single memory access */
+#define TASK_SLICE_END	MAX(MAX(MAX(NEXT, MEM), MAX(ONCPU, PID)) + 4, COMM + 16)
+#define TASK_SLICE_SIZE	((TASK_SLICE_END + 3) & ~3)
 
-	if (retval == ERROR_OK) {
-		uint32_t val = get_buffer(target, buffer);
-		t->state = val;
-	} else
-		LOG_ERROR("fill_task: unable to read memory");
+static void decode_name(struct target *target, struct threads *t,
+	const uint8_t *comm)
+{
+	for (int i = 0; i < 4; i++) {
+		uint32_t raw_name = target_buffer_get_u32(target, comm + 4 * i);
+		t->name[4 * i + 3] = raw_name >> 24;
+		t->name[4 * i + 2] = raw_name >> 16;
+		t->name[4 * i + 1] = raw_name >> 8;
+		t->name[4 * i] = raw_name;
+	}
+	t->name[16] = 0;
+}
 
-	retval = fill_buffer(target, pid_addr, buffer);
+/*  fill state, pid, oncpu, name and asid of a task, and optionally the
+ *  address of the next task, from one read of the task_struct */
+static int fill_task(struct target *target, struct threads *t, uint32_t *next)
+{
+	uint8_t *buffer = malloc(TASK_SLICE_SIZE);
+	if (!buffer)
+		return ERROR_FAIL;
 
-	if (retval == ERROR_OK) {
-		uint32_t val = get_buffer(target, buffer);
-		t->pid = val;
-	} else
+	int retval = linux_read_memory(target, t->base_addr, 4,
+			TASK_SLICE_SIZE / 4, buffer);
+	if (retval != ERROR_OK) {
 		LOG_ERROR("fill task: unable to read memory");
+		free(buffer);
+		return retval;
+	}
 
-	retval = fill_buffer(target, on_cpu, buffer);
-
-	if (retval == ERROR_OK) {
-		uint32_t val = get_buffer(target, buffer);
-		t->oncpu = val;
-	} else
-		LOG_ERROR("fill task: unable to read memory");
+	t->state = get_buffer(target, buffer);
+	t->pid = get_buffer(target, buffer + PID);
+	t->oncpu = get_buffer(target, buffer + ONCPU);
+	decode_name(target, t, buffer + COMM);
 
-	retval = fill_buffer(target, mem_addr, buffer);
+	if (next)
+		*next = get_buffer(target, buffer + NEXT) - NEXT;
 
-	if (retval == ERROR_OK) {
-		uint32_t val = get_buffer(target, buffer);
+	uint32_t mm = get_buffer(target, buffer + MEM);
+	t->asid = 0;
 
-		if (val != 0) {
-			uint32_t asid_addr = val + MM_CTX;
-			retval = fill_buffer(target, asid_addr, buffer);
+	if (mm != 0) {
+		retval = fill_buffer(target, mm + MM_CTX, buffer);
 
-			if (retval == ERROR_OK) {
-				val = get_buffer(target, buffer);
-				t->asid = val;
-			} else
-				LOG_ERROR
-					("fill task: unable to read memory -- ASID");
-		} else
-			t->asid = 0;
-	} else
-		LOG_ERROR("fill task: unable to read memory");
+		if (retval == ERROR_OK)
+			t->asid = get_buffer(target, buffer);
+		else
+			LOG_ERROR("fill task: unable to read memory -- ASID");
+	}
 
 	free(buffer);
 
@@ -338,48 +344,19 @@ static int fill_task(struct target *target, struct threads *t)
 
 static int get_name(struct target *target, struct threads *t)
 {
-	int retval;
-	uint32_t full_name[4];
-	uint32_t comm = t->base_addr + COMM;
-	int i;
+	uint8_t comm[16];
 
-	for (i = 0; i < 17; i++)
-		t->name[i] = 0;
+	memset(t->name, 0, sizeof(t->name));
 
-	retval = linux_read_memory(target, comm, 4, 4, (uint8_t *) full_name);
+	int retval = linux_read_memory(target, t->base_addr + COMM, 4, 4, comm);
 
 	if (retval != ERROR_OK) {
 		LOG_ERROR("get_name: unable to read memory\n");
 		return ERROR_FAIL;
 	}
 
-	uint32_t raw_name = target_buffer_get_u32(target,
-			(const uint8_t *)
-			&full_name[0]);
-	t->name[3] = raw_name >> 24;
-	t->name[2] = raw_name >> 16;
-	t->name[1] = raw_name >> 8;
-	t->name[0] = raw_name;
-	raw_name =
-		target_buffer_get_u32(target, (const uint8_t *)&full_name[1]);
-	t->name[7] = raw_name >> 24;
-	t->name[6] = raw_name >> 16;
-	t->name[5] = raw_name >> 8;
-	t->name[4] = raw_name;
-	raw_name =
-		target_buffer_get_u32(target, (const uint8_t *)&full_name[2]);
-	t->name[11] = raw_name >> 24;
-	t->name[10] = raw_name >> 16;
-	t->name[9] = raw_name >> 8;
-	t->name[8] = raw_name;
-	raw_name =
-		target_buffer_get_u32(target, (const uint8_t *)&full_name[3]);
-	t->name[15] = raw_name >> 24;
-	t->name[14] = raw_name >> 16;
-	t->name[13] = raw_name >> 8;
-	t->name[12] = raw_name;
+	decode_name(target, t, comm);
 	return ERROR_OK;
-
 }
 
 static int get_current(struct target *target, int create)
@@ -444,8 +421,7 @@ static int get_current(struct target *target, int create)
 					struct threads *t;
 					t = calloc(1, sizeof(struct threads));
 					t->base_addr = ct->TS;
-					fill_task(target, t);
-					get_name(target, t);
+					fill_task(target, t, NULL);
 					t->oncpu = cpu;
 					insert_into_threadlist(target, t);
 					t->status = 3;
@@ -692,9 +668,10 @@ static int linux_get_tasks(struct target *target, int context)
 
 	while (((t->base_addr != linux_os->init_task_addr) &&
 		(t->base_addr != 0)) || (loop == 0)) {
+		uint32_t next_addr = 0;
+
 		loop++;
-		fill_task(target, t);
-		retval = get_name(target, t);
+		retval = fill_task(target, t, &next_addr);
 
 		if (loop > MAX_THREADS) {
 			free(t);
@@ -709,7 +686,6 @@ static int linux_get_tasks(struct target *target, int context)
 
 		/*  check that this thread is not one the current threads already
 		 *  created */
-		uint32_t base_addr;
 #ifdef PID_CHECK
 
 		if (!current_pid(linux_os, t->pid)) {
@@ -730,15 +706,13 @@ static int linux_get_tasks(struct target *target, int context)
 				t->context =
 					cpu_context_read(target, t->base_addr,
 						&t->thread_info_addr);
-			base_addr = next_task(target, t);
 		} else {
 			/*LOG_INFO("thread %s is a current thread already created",t->name); */
-			base_addr = next_task(target, t);
 			free(t);
 		}
 
 		t = calloc(1, sizeof(struct threads));
-		t->base_addr = base_addr;
+		t->base_addr = next_addr;
 	}
 
 	linux_os->threads_lookup = 1;
@@ -856,10 +830,9 @@ error_handling:
 
 			if (!found) {
 				/*  it is a new thread */
-				if (fill_task(target, t) != ERROR_OK)
+				if (fill_task(target, t, NULL) != ERROR_OK)
 					goto error_handling;
 
-				get_name(target, t);
 				insert_into_threadlist(target, t);
 				t->thread_info_addr = 0xdeadbeef;
 			}
@@ -992,9 +965,8 @@ static int linux_task_update(struct target *target, int context)
 		}
 
 		if (found == 0) {
-			uint32_t base_addr;
-			fill_task(target, t);
-			get_name(target, t);
+			uint32_t base_addr = 0;
+			fill_task(target, t, &base_addr);
 			retval = insert_into_threadlist(target, t);
 			t->thread_info_addr = 0xdeadbeef;
 
@@ -1003,7 +975,6 @@ static int linux_task_update(struct target *target, int context)
 					cpu_context_read(target, t->base_addr,
 						&t->thread_info_addr);
 
-			base_addr = next_task(target, t);
 			t = calloc(1, sizeof(struct threads));
 			t->base_addr = base_addr;
 			linux_os->thread_count++;
@@ -193,6 +193,7 @@ static int nuttx_update_threads(struct rtos *rtos)
 {
 	struct tcbinfo tcbinfo;
 	uint32_t pidhashaddr, npidhash, tcbaddr;
+	uint8_t *tcb = NULL;
 	uint16_t pid;
 	uint8_t state;
 
@@ -265,6 +266,21 @@ static int nuttx_update_threads(struct rtos *rtos)
 	}
 	rtos->current_thread = current_thread;
 
+	/* PID, state and name of a TCB are read with a single access */
+	uint16_t tcb_start = MIN(tcbinfo.pid_off, tcbinfo.state_off);
+	uint32_t tcb_end = MAX(tcbinfo.pid_off + 2, tcbinfo.state_off + 1);
+	if (tcbinfo.name_off) {
+		tcb_start = MIN(tcb_start, tcbinfo.name_off);
+		tcb_end = MAX(tcb_end, tcbinfo.name_off + NAME_SIZE);
+	}
+
+	tcb = malloc(tcb_end - tcb_start);
+	if (!tcb) {
+		LOG_ERROR("Failed to allocate TCB buffer");
+		ret = ERROR_FAIL;
+		goto errout;
+	}
+
 	uint32_t thread_count = 0;
 
 	for (unsigned int i = 0; i < npidhash; i++) {
@@ -273,19 +289,16 @@ static int nuttx_update_threads(struct rtos *rtos)
 		if (!tcbaddr)
 			continue;
 
-		ret = target_read_u16(rtos->target, tcbaddr + tcbinfo.pid_off, &pid);
+		ret = target_read_buffer(rtos->target, tcbaddr + tcb_start,
+			tcb_end - tcb_start, tcb);
 		if (ret != ERROR_OK) {
-			LOG_ERROR("Failed to read PID of TCB@0x%x from pidhash[%d]: ret = %d",
+			LOG_ERROR("Failed to read TCB@0x%x from pidhash[%d]: ret = %d",
 				tcbaddr, i, ret);
 			goto errout;
 		}
 
-		ret = target_read_u8(rtos->target, tcbaddr + tcbinfo.state_off, &state);
-		if (ret != ERROR_OK) {
-			LOG_ERROR("Failed to read state of TCB@0x%x from pidhash[%d]: ret = %d",
-				tcbaddr, i, ret);
-			goto errout;
-		}
+		pid = target_buffer_get_u16(rtos->target, tcb + tcbinfo.pid_off - tcb_start);
+		state = tcb[tcbinfo.state_off - tcb_start];
 
 		struct thread_detail *new_thread_details = realloc(rtos->thread_details,
 			sizeof(struct thread_detail) * (thread_count + 1));
@@ -319,12 +332,8 @@ static int nuttx_update_threads(struct rtos *rtos)
 				ret = ERROR_FAIL;
 				goto errout;
 			}
-			ret = target_read_buffer(rtos->target, tcbaddr + tcbinfo.name_off,
-				sizeof(char) * NAME_SIZE, (uint8_t *)thread->thread_name_str);
-			if (ret != ERROR_OK) {
-				LOG_ERROR("Failed to read thread's name: ret = %d", ret);
-				goto errout;
-			}
+			memcpy(thread->thread_name_str, tcb + tcbinfo.name_off - tcb_start,
+				sizeof(char) * NAME_SIZE);
 		} else {
 			thread->thread_name_str = strdup("None");
 		}
@@ -333,6 +342,7 @@ static int nuttx_update_threads(struct rtos *rtos)
 	ret = ERROR_OK;
 	rtos->thread_count = thread_count;
 errout:
+	free(tcb);
 	free(pidhash);
 	return ret;
 }
@@ -52,6 +52,28 @@ static int rtos_target_for_threadid(struct connection *connection, int64_t threa
 	return ERROR_OK;
 }
 
+static void rtos_free_reg_cache(struct rtos *rtos)
+{
+	for (int i = 0; i < rtos->reg_cache_count; i++)
+		free(rtos->reg_cache[i].reg_list);
+
+	free(rtos->reg_cache);
+	rtos->reg_cache = NULL;
+	rtos->reg_cache_count = 0;
+}
+
+static int rtos_target_event_callback(struct target *target,
+		enum target_event event, void *priv)
+{
+	struct rtos *rtos = priv;
+
+	/* the thread registers may change whenever the target runs */
+	if (event == TARGET_EVENT_HALTED || event == TARGET_EVENT_RESUMED)
+		rtos_free_reg_cache(rtos);
+
+	return ERROR_OK;
+}
+
 static int os_alloc(struct target *target, const struct rtos_type *ostype)
 {
 	struct rtos *os = target->rtos = calloc(1, sizeof(struct rtos));
@@ -69,6 +91,8 @@ static int os_alloc(struct target *target, const struct rtos_type *ostype)
 	os->gdb_thread_packet = rtos_thread_packet;
 	os->gdb_target_for_threadid = rtos_target_for_threadid;
 
+	target_register_event_callback(rtos_target_event_callback, os);
+
 	return JIM_OK;
 }
 
@@ -77,6 +101,12 @@ static void os_free(struct target *target)
 	if (!target->rtos)
 		return;
 
+	target_unregister_event_callback(rtos_target_event_callback, target->rtos);
+	rtos_free_reg_cache(target->rtos);
+
+	if (target->rtos->type->free_driver_priv)
+		target->rtos->type->free_driver_priv(target->rtos);
+
 	free(target->rtos->symbols);
 	free(target->rtos);
 	target->rtos = NULL;
@@ -498,6 +528,50 @@ static int rtos_put_gdb_reg_list(struct connection *connection,
 	return ERROR_OK;
 }
 
+/**
+ * Get the register list of a thread. GDB front ends often ask for the
+ * registers of every thread on each stop, so the lists are cached until the
+ * target runs, or until registers or memory are written.
+ *
+ * The registers of hwthread are those of the cores, which can be written
+ * without going through the RTOS layer, so they are always read again.
+ *
+ * The returned list is owned by the cache.
+ */
+static int rtos_get_thread_reg_list(struct rtos *rtos, int64_t threadid,
+		struct rtos_reg **reg_list, int *num_regs)
+{
+	if (rtos->type == &hwthread_rtos)
+		rtos_free_reg_cache(rtos);
+
+	for (int i = 0; i < rtos->reg_cache_count; i++) {
+		if (rtos->reg_cache[i].threadid == threadid) {
+			*reg_list = rtos->reg_cache[i].reg_list;
+			*num_regs = rtos->reg_cache[i].num_regs;
+			return ERROR_OK;
+		}
+	}
+
+	struct rtos_thread_regs *cache = realloc(rtos->reg_cache,
+			(rtos->reg_cache_count + 1) * sizeof(*cache));
+	if (!cache) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	rtos->reg_cache = cache;
+
+	int retval = rtos->type->get_thread_reg_list(rtos, threadid, reg_list, num_regs);
+	if (retval != ERROR_OK)
+		return retval;
+
+	cache[rtos->reg_cache_count].threadid = threadid;
+	cache[rtos->reg_cache_count].reg_list = *reg_list;
+	cache[rtos->reg_cache_count].num_regs = *num_regs;
+	rtos->reg_cache_count++;
+
+	return ERROR_OK;
+}
+
 /** Look through all registers to find this register. */
 int rtos_get_gdb_reg(struct connection *connection, int reg_num)
 {
@@ -517,7 +591,8 @@ int rtos_get_gdb_reg(struct connection *connection, int reg_num)
 										target->rtos->current_thread);
 
 		int retval;
-		if (target->rtos->type->get_thread_reg) {
+		bool cached = !target->rtos->type->get_thread_reg;
+		if (!cached) {
 			reg_list = calloc(1, sizeof(*reg_list));
 			num_regs = 1;
 			retval = target->rtos->type->get_thread_reg(target->rtos,
@@ -527,7 +602,7 @@ int rtos_get_gdb_reg(struct connection *connection, int reg_num)
 				return retval;
 			}
 		} else {
-			retval = target->rtos->type->get_thread_reg_list(target->rtos,
+			retval = rtos_get_thread_reg_list(target->rtos,
 					current_threadid,
 					&reg_list,
 					&num_regs);
@@ -540,12 +615,14 @@ int rtos_get_gdb_reg(struct connection *connection, int reg_num)
 		for (int i = 0; i < num_regs; ++i) {
 			if (reg_list[i].number == (uint32_t)reg_num) {
 				rtos_put_gdb_reg_list(connection, reg_list + i, 1);
-				free(reg_list);
+				if (!cached)
+					free(reg_list);
 				return ERROR_OK;
 			}
 		}
 
-		free(reg_list);
+		if (!cached)
+			free(reg_list);
 	}
 	return ERROR_FAIL;
 }
@@ -567,7 +644,7 @@ int rtos_get_gdb_reg_list(struct connection *connection)
 										current_threadid,
 										target->rtos->current_thread);
 
-		int retval = target->rtos->type->get_thread_reg_list(target->rtos,
+		int retval = rtos_get_thread_reg_list(target->rtos,
 				current_threadid,
 				&reg_list,
 				&num_regs);
@@ -577,7 +654,6 @@ int rtos_get_gdb_reg_list(struct connection *connection)
 		}
 
 		rtos_put_gdb_reg_list(connection, reg_list, num_regs);
-		free(reg_list);
 
 		return ERROR_OK;
 	}
@@ -589,6 +665,9 @@ int rtos_set_reg(struct connection *connection, int reg_num,
 {
 	struct target *target = get_target_from_connection(connection);
 	int64_t current_threadid = target->rtos->current_threadid;
+
+	rtos_free_reg_cache(target->rtos);
+
 	if ((target->rtos) &&
 			(target->rtos->type->set_reg) &&
 			(current_threadid != -1) &&
@@ -684,24 +763,56 @@ static int rtos_try_next(struct target *target)
 	return 1;
 }
 
+/** Drop the cached thread register lists, when registers or memory change. */
+void rtos_reg_cache_invalidate(struct target *target)
+{
+	if (target->rtos)
+		rtos_free_reg_cache(target->rtos);
+}
+
 int rtos_update_threads(struct target *target)
 {
-	if ((target->rtos) && (target->rtos->type))
+	if ((target->rtos) && (target->rtos->type)) {
+		/* the target may have run since the registers were read */
+		rtos_free_reg_cache(target->rtos);
 		target->rtos->type->update_threads(target->rtos);
+	}
 	return ERROR_OK;
 }
 
+void rtos_free_thread_details(struct thread_detail *details, int count)
+{
+	for (int j = 0; j < count; j++) {
+		free(details[j].thread_name_str);
+		free(details[j].extra_info_str);
+	}
+	free(details);
+}
+
 void rtos_free_threadlist(struct rtos *rtos)
 {
 	if (rtos->thread_details) {
-		int j;
+		rtos_free_thread_details(rtos->thread_details, rtos->thread_count);
+		rtos->thread_details = NULL;
+		rtos->thread_count = 0;
+		rtos->current_threadid = -1;
+		rtos->current_thread = 0;
+	}
+}
 
-		for (j = 0; j < rtos->thread_count; j++) {
-			struct thread_detail *current_thread = &rtos->thread_details[j];
-			free(current_thread->thread_name_str);
-			free(current_thread->extra_info_str);
-		}
-		free(rtos->thread_details);
+/**
+ * Like rtos_free_threadlist(), but hand the previous thread list over to the
+ * caller instead of freeing it. This lets an RTOS reuse the details of threads
+ * which still exist, see rtos_take_thread_name(). The caller frees the list
+ * with rtos_free_thread_details().
+ */
+void rtos_detach_threadlist(struct rtos *rtos, struct thread_detail **details,
+		int *count)
+{
+	*details = rtos->thread_details;
+	*count = rtos->thread_details ? rtos->thread_count : 0;
+
+	if (rtos->thread_details) {
 		rtos->thread_details = NULL;
 		rtos->thread_count = 0;
 		rtos->current_threadid = -1;
@@ -709,6 +820,27 @@ void rtos_free_threadlist(struct rtos *rtos)
 	}
 }
 
+/**
+ * Take over the name of a thread from a detached thread list.
+ *
+ * @returns The name, owned by the caller, or NULL if the thread was not in the
+ *          list.
+ */
+char *rtos_take_thread_name(struct thread_detail *details, int count,
+		threadid_t threadid)
+{
+	for (int j = 0; j < count; j++) {
+		if (details[j].threadid == threadid) {
+			char *name = details[j].thread_name_str;
+
+			details[j].thread_name_str = NULL;
+			return name;
+		}
+	}
+
+	return NULL;
+}
+
 int rtos_read_buffer(struct target *target, target_addr_t address,
 		uint32_t size, uint8_t *buffer)
 {
@@ -720,6 +852,9 @@ int rtos_read_buffer(struct target *target, target_addr_t address,
 int rtos_write_buffer(struct target *target, target_addr_t address,
 		uint32_t size, const uint8_t *buffer)
 {
+	/* the write may change the stack frame of a thread */
+	rtos_free_reg_cache(target->rtos);
+
 	if (target->rtos->type->write_buffer)
 		return target->rtos->type->write_buffer(target->rtos, address, size, buffer);
 	return ERROR_NOT_IMPLEMENTED;
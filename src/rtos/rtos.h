@@ -33,6 +33,13 @@ struct thread_detail {
 	char *extra_info_str;
 };
 
+/** Register list of a thread, kept until the target resumes. */
+struct rtos_thread_regs {
+	int64_t threadid;
+	struct rtos_reg *reg_list;
+	int num_regs;
+};
+
 struct rtos {
 	const struct rtos_type *type;
 
@@ -48,6 +55,9 @@ struct rtos {
 	int (*gdb_thread_packet)(struct connection *connection, char const *packet, int packet_size);
 	int (*gdb_target_for_threadid)(struct connection *connection, int64_t thread_id, struct target **p_target);
 	void *rtos_specific_params;
+	/* Register lists read since the last thread list update. */
+	struct rtos_thread_regs *reg_cache;
+	int reg_cache_count;
 };
 
 struct rtos_reg {
@@ -78,6 +88,8 @@ struct rtos_type {
 			uint8_t *buffer);
 	int (*write_buffer)(struct rtos *rtos, target_addr_t address, uint32_t size,
 			const uint8_t *buffer);
+	/** Free rtos_specific_params, if create() allocated it. */
+	void (*free_driver_priv)(struct rtos *rtos);
 };
 
 struct stack_register_offset {
@@ -127,7 +139,13 @@ int rtos_thread_packet(struct connection *connection, const char *packet, int pa
 int rtos_get_gdb_reg(struct connection *connection, int reg_num);
 int rtos_get_gdb_reg_list(struct connection *connection);
 int rtos_update_threads(struct target *target);
+void rtos_reg_cache_invalidate(struct target *target);
 void rtos_free_threadlist(struct rtos *rtos);
+void rtos_detach_threadlist(struct rtos *rtos, struct thread_detail **details,
+		int *count);
+void rtos_free_thread_details(struct thread_detail *details, int count);
+char *rtos_take_thread_name(struct thread_detail *details, int count,
+		threadid_t threadid);
 int rtos_smp_init(struct target *target);
 /*  function for handling symbol access */
 int rtos_qsymbol(struct connection *connection, char const *packet, int packet_size);
@@ -26,6 +26,9 @@
 
 #define UNIMPLEMENTED 0xFFFFFFFFU
 
+/* Largest span of the thread members read with a single access. */
+#define ZEPHYR_THREAD_SPAN_MAX 1024
+
 /* ARC specific defines */
 #define ARC_AUX_SEC_BUILD_REG 0xdb
 #define ARC_REG_NUM 38
@@ -503,7 +506,9 @@ static uint32_t zephyr_kptr(const struct rtos *rtos, enum zephyr_offsets off)
 	return rtos->symbols[ZEPHYR_VAL__KERNEL].address + params->offsets[off];
 }
 
-static int zephyr_fetch_thread(const struct rtos *rtos,
+/* Read the members of a thread one by one, when they are too far apart to be
+ * read with a single access. */
+static int zephyr_fetch_thread_fields(const struct rtos *rtos,
 				struct zephyr_thread *thread, uint32_t ptr)
 {
 	const struct zephyr_params *param = rtos->rtos_specific_params;
@@ -557,6 +562,99 @@ static int zephyr_fetch_thread(const struct rtos *rtos,
 		thread->name[sizeof(thread->name) - 1] = '\0';
 	}
 
+	return ERROR_OK;
+}
+
+/* Read the members of a thread, found between offsets start and end, with a
+ * single access. */
+static int zephyr_fetch_thread_span(const struct rtos *rtos,
+				struct zephyr_thread *thread, uint32_t ptr,
+				uint32_t start, uint32_t end)
+{
+	const struct zephyr_params *param = rtos->rtos_specific_params;
+	int retval;
+
+	uint8_t *buf = malloc(end - start);
+	if (!buf)
+		return ERROR_FAIL;
+
+	retval = target_read_buffer(rtos->target, ptr + start, end - start, buf);
+	if (retval != ERROR_OK) {
+		free(buf);
+		return retval;
+	}
+
+	thread->ptr = ptr;
+	thread->entry = target_buffer_get_u32(rtos->target,
+			buf + param->offsets[OFFSET_T_ENTRY] - start);
+	thread->next_ptr = target_buffer_get_u32(rtos->target,
+			buf + param->offsets[OFFSET_T_NEXT_THREAD] - start);
+	thread->stack_pointer = target_buffer_get_u32(rtos->target,
+			buf + param->offsets[OFFSET_T_STACK_POINTER] - start);
+	thread->state = buf[param->offsets[OFFSET_T_STATE] - start];
+	thread->user_options = buf[param->offsets[OFFSET_T_USER_OPTIONS] - start];
+	thread->prio = buf[param->offsets[OFFSET_T_PRIO] - start];
+
+	thread->name[0] = '\0';
+	if (param->offsets[OFFSET_T_NAME] != UNIMPLEMENTED) {
+		memcpy(thread->name, buf + param->offsets[OFFSET_T_NAME] - start,
+				sizeof(thread->name) - 1);
+		thread->name[sizeof(thread->name) - 1] = '\0';
+	}
+
+	free(buf);
+
+	return ERROR_OK;
+}
+
+static int zephyr_fetch_thread(const struct rtos *rtos,
+				struct zephyr_thread *thread, uint32_t ptr)
+{
+	const struct zephyr_params *param = rtos->rtos_specific_params;
+	const struct {
+		enum zephyr_offsets offset;
+		uint32_t size;
+	} fields[] = {
+		{ OFFSET_T_ENTRY, 4 },
+		{ OFFSET_T_NEXT_THREAD, 4 },
+		{ OFFSET_T_STACK_POINTER, 4 },
+		{ OFFSET_T_STATE, 1 },
+		{ OFFSET_T_USER_OPTIONS, 1 },
+		{ OFFSET_T_PRIO, 1 },
+		{ OFFSET_T_NAME, sizeof(thread->name) - 1 },
+	};
+	uint32_t start = UINT32_MAX;
+	uint32_t end = 0;
+	bool wrapped = false;
+	int retval;
+
+	/* all members are read with a single access */
+	for (size_t i = 0; i < ARRAY_SIZE(fields); i++) {
+		uint32_t offset = param->offsets[fields[i].offset];
+
+		if (offset == UNIMPLEMENTED) {
+			/* only the name is optional */
+			if (fields[i].offset == OFFSET_T_NAME)
+				continue;
+			LOG_ERROR("Zephyr: offset of a thread member is not available");
+			return ERROR_FAIL;
+		}
+
+		if (offset > UINT32_MAX - fields[i].size)
+			wrapped = true;
+
+		start = MIN(start, offset);
+		end = MAX(end, offset + fields[i].size);
+	}
+
+	/* the offsets come from the target, don't trust them with the buffer */
+	if (wrapped || end - start > ZEPHYR_THREAD_SPAN_MAX)
+		retval = zephyr_fetch_thread_fields(rtos, thread, ptr);
+	else
+		retval = zephyr_fetch_thread_span(rtos, thread, ptr, start, end);
+	if (retval != ERROR_OK)
+		return retval;
+
 	LOG_DEBUG("Fetched thread%" PRIx32 ": {entry@0x%" PRIx32
 		", state=%" PRIu8 ", useropts=%" PRIu8 ", prio=%" PRId8 "}",
 		ptr, thread->entry, thread->state, thread->user_options, thread->prio);
@@ -708,19 +806,23 @@ static int zephyr_update_threads(struct rtos *rtos)
 	}
 	/* We can fetch the whole array for version 0, as they're supposed
 	 * to grow only */
-	uint32_t address;
-	address  = rtos->symbols[ZEPHYR_VAL__KERNEL_OPENOCD_OFFSETS].address;
-	for (size_t i = 0; i < OFFSET_MAX; i++, address += param->size_width) {
-		if (i >= param->num_offsets) {
-			param->offsets[i] = UNIMPLEMENTED;
-			continue;
-		}
+	uint8_t offsets[OFFSET_MAX * sizeof(uint32_t)];
+	size_t num_offsets = MIN(param->num_offsets, OFFSET_MAX);
 
-		retval = target_read_u32(rtos->target, address, &param->offsets[i]);
-		if (retval != ERROR_OK) {
-			LOG_ERROR("Could not fetch offsets from Zephyr");
-			return ERROR_FAIL;
-		}
+	retval = target_read_buffer(rtos->target,
+			rtos->symbols[ZEPHYR_VAL__KERNEL_OPENOCD_OFFSETS].address,
+			num_offsets * param->size_width, offsets);
+	if (retval != ERROR_OK) {
+		LOG_ERROR("Could not fetch offsets from Zephyr");
+		return ERROR_FAIL;
+	}
+
+	for (size_t i = 0; i < OFFSET_MAX; i++) {
+		if (i >= num_offsets)
+			param->offsets[i] = UNIMPLEMENTED;
+		else
+			param->offsets[i] = target_buffer_get_u32(rtos->target,
+					offsets + i * param->size_width);
 	}
 
 	LOG_DEBUG("Zephyr OpenOCD support version %" PRId32,
@@ -14,6 +14,7 @@
 
 #include <helper/log.h>
 #include <helper/list.h>
+#include <helper/time_support.h>
 #include <target/target.h>
 #include <target/rtt.h>
 
@@ -40,9 +41,27 @@ static struct {
 	bool found_cb;
 
 	struct rtt_sink_list **sink_list;
+	/** Up-channel statistics, same length as the sink list. */
+	struct rtt_channel_stats *stats;
 	size_t sink_list_length;
 
 	unsigned int polling_interval;
+
+	/** Whether the polling interval adapts to the channel fill level. */
+	bool adaptive;
+	/** Lower bound of the adaptive polling interval in ms. */
+	unsigned int min_interval;
+	/** Upper bound of the adaptive polling interval in ms. */
+	unsigned int max_interval;
+	/** Current adaptive polling interval in ms. */
+	unsigned int interval;
+	/** Time of the next adaptive poll, see timeval_ms(). */
+	int64_t next_poll;
+
+	/** Address where the control block was last found. */
+	target_addr_t cb_hint;
+	/** Whether the control block was found before. */
+	bool cb_hint_valid;
 } rtt;
 
 int rtt_init(void)
@@ -50,31 +69,74 @@ int rtt_init(void)
 	rtt.sink_list_length = 1;
 	rtt.sink_list = calloc(rtt.sink_list_length,
 		sizeof(struct rtt_sink_list *));
+	rtt.stats = calloc(rtt.sink_list_length,
+		sizeof(struct rtt_channel_stats));
 
-	if (!rtt.sink_list)
+	if (!rtt.sink_list || !rtt.stats) {
+		free(rtt.sink_list);
+		free(rtt.stats);
 		return ERROR_FAIL;
+	}
 
 	rtt.sink_list[0] = NULL;
 	rtt.started = false;
 
 	rtt.polling_interval = 100;
 
+	rtt.adaptive = false;
+	rtt.min_interval = 1;
+	rtt.max_interval = 100;
+
 	return ERROR_OK;
 }
 
 int rtt_exit(void)
 {
 	free(rtt.sink_list);
+	free(rtt.stats);
 
 	return ERROR_OK;
 }
 
+/*
+ * Halve the polling interval when a channel was found at least half full,
+ * double it when no channel had any data.
+ */
+static void adapt_polling_interval(void)
+{
+	bool idle = true;
+	bool busy = false;
+
+	for (size_t i = 0; i < rtt.sink_list_length; i++) {
+		const struct rtt_channel_stats *stats = &rtt.stats[i];
+
+		if (!stats->last_length)
+			continue;
+
+		idle = false;
+
+		if (stats->last_length >= stats->size / 2)
+			busy = true;
+	}
+
+	if (busy)
+		rtt.interval = MAX(rtt.interval / 2, rtt.min_interval);
+	else if (idle)
+		rtt.interval = MIN(rtt.interval * 2, rtt.max_interval);
+
+	rtt.next_poll = timeval_ms() + rtt.interval;
+}
+
 static int read_channel_callback(void *user_data)
 {
 	int ret;
 
+	/* the timer runs at the lower bound, skip the ticks in between */
+	if (rtt.adaptive && timeval_ms() < rtt.next_poll)
+		return ERROR_OK;
+
 	ret = rtt.source.read(rtt.target, &rtt.ctrl, rtt.sink_list,
-		rtt.sink_list_length, NULL);
+		rtt.stats, rtt.sink_list_length, NULL);
 
 	if (ret != ERROR_OK) {
 		target_unregister_timer_callback(&read_channel_callback, NULL);
@@ -82,9 +144,17 @@ static int read_channel_callback(void *user_data)
 		return ret;
 	}
 
+	if (rtt.adaptive)
+		adapt_polling_interval();
+
 	return ERROR_OK;
 }
 
+static unsigned int timer_interval(void)
+{
+	return rtt.adaptive ? rtt.min_interval : rtt.polling_interval;
+}
+
 int rtt_setup(target_addr_t address, size_t size, const char *id)
 {
 	size_t id_length = strlen(id);
@@ -121,6 +191,19 @@ int rtt_register_source(const struct rtt_source source,
 	return ERROR_OK;
 }
 
+/* Check whether the control block with the configured ID is at an address. */
+static bool check_control_block(target_addr_t address)
+{
+	target_addr_t addr = address;
+	bool found;
+
+	if (rtt.source.find_cb(rtt.target, &addr, strlen(rtt.id), rtt.id, &found,
+			NULL) != ERROR_OK)
+		return false;
+
+	return found;
+}
+
 int rtt_start(void)
 {
 	int ret;
@@ -129,9 +212,26 @@ int rtt_start(void)
 	if (rtt.started)
 		return ERROR_OK;
 
+	if (rtt.found_cb && !rtt.changed) {
+		/* the firmware may have been replaced since the last start */
+		if (!check_control_block(rtt.ctrl.address))
+			rtt.found_cb = false;
+	}
+
 	if (!rtt.found_cb || rtt.changed) {
-		rtt.source.find_cb(rtt.target, &addr, rtt.size, rtt.id,
-			&rtt.found_cb, NULL);
+		/*
+		 * Try the previously found address first, the control block rarely
+		 * moves between builds of the same firmware.
+		 */
+		if (rtt.cb_hint_valid && rtt.cb_hint >= rtt.addr &&
+				rtt.cb_hint - rtt.addr + RTT_CB_SIZE <= rtt.size &&
+				check_control_block(rtt.cb_hint)) {
+			addr = rtt.cb_hint;
+			rtt.found_cb = true;
+		} else {
+			rtt.source.find_cb(rtt.target, &addr, rtt.size, rtt.id,
+				&rtt.found_cb, NULL);
+		}
 
 		rtt.changed = false;
 
@@ -139,6 +239,8 @@ int rtt_start(void)
 			LOG_INFO("rtt: Control block found at 0x%" TARGET_PRIxADDR,
 				addr);
 			rtt.ctrl.address = addr;
+			rtt.cb_hint = addr;
+			rtt.cb_hint_valid = true;
 		} else {
 			LOG_INFO("rtt: No control block found");
 			return ERROR_OK;
@@ -155,8 +257,11 @@ int rtt_start(void)
 	if (ret != ERROR_OK)
 		return ret;
 
+	rtt.interval = rtt.min_interval;
+	rtt.next_poll = 0;
+
 	target_register_timer_callback(&read_channel_callback,
-		rtt.polling_interval, 1, NULL);
+		timer_interval(), 1, NULL);
 	rtt.started = true;
 
 	return ERROR_OK;
@@ -185,6 +290,7 @@ int rtt_stop(void)
 static int adjust_sink_list(size_t length)
 {
 	struct rtt_sink_list **tmp;
+	struct rtt_channel_stats *stats;
 
 	if (length <= rtt.sink_list_length)
 		return ERROR_OK;
@@ -194,10 +300,20 @@ static int adjust_sink_list(size_t length)
 	if (!tmp)
 		return ERROR_FAIL;
 
-	for (size_t i = rtt.sink_list_length; i < length; i++)
+	rtt.sink_list = tmp;
+
+	stats = realloc(rtt.stats, sizeof(struct rtt_channel_stats) * length);
+
+	if (!stats)
+		return ERROR_FAIL;
+
+	rtt.stats = stats;
+
+	for (size_t i = rtt.sink_list_length; i < length; i++) {
 		tmp[i] = NULL;
+		memset(&stats[i], 0, sizeof(stats[i]));
+	}
 
-	rtt.sink_list = tmp;
 	rtt.sink_list_length = length;
 
 	return ERROR_OK;
@@ -274,7 +390,7 @@ int rtt_set_polling_interval(unsigned int interval)
 	if (!interval)
 		return ERROR_FAIL;
 
-	if (rtt.polling_interval != interval) {
+	if (rtt.polling_interval != interval && !rtt.adaptive) {
 		target_unregister_timer_callback(&read_channel_callback, NULL);
 		target_register_timer_callback(&read_channel_callback, interval, 1,
 			NULL);
@@ -285,6 +401,57 @@ int rtt_set_polling_interval(unsigned int interval)
 	return ERROR_OK;
 }
 
+int rtt_get_adaptive_polling(bool *enabled, unsigned int *min_interval,
+		unsigned int *max_interval)
+{
+	if (!enabled || !min_interval || !max_interval)
+		return ERROR_FAIL;
+
+	*enabled = rtt.adaptive;
+	*min_interval = rtt.min_interval;
+	*max_interval = rtt.max_interval;
+
+	return ERROR_OK;
+}
+
+int rtt_set_adaptive_polling(bool enabled, unsigned int min_interval,
+		unsigned int max_interval)
+{
+	if (enabled && (!min_interval || min_interval > max_interval))
+		return ERROR_FAIL;
+
+	if (rtt.started) {
+		target_unregister_timer_callback(&read_channel_callback, NULL);
+		target_register_timer_callback(&read_channel_callback,
+			enabled ? min_interval : rtt.polling_interval, 1, NULL);
+	}
+
+	rtt.adaptive = enabled;
+
+	if (enabled) {
+		rtt.min_interval = min_interval;
+		rtt.max_interval = max_interval;
+		rtt.interval = min_interval;
+		rtt.next_poll = 0;
+	}
+
+	return ERROR_OK;
+}
+
+const struct rtt_channel_stats *rtt_get_channel_stats(unsigned int channel_index)
+{
+	if (channel_index >= rtt.sink_list_length)
+		return NULL;
+
+	return &rtt.stats[channel_index];
+}
+
+void rtt_add_channel_dropped(unsigned int channel_index, uint64_t length)
+{
+	if (channel_index < rtt.sink_list_length)
+		rtt.stats[channel_index].dropped += length;
+}
+
 int rtt_write_channel(unsigned int channel_index, const uint8_t *buffer,
 		size_t *length)
 {
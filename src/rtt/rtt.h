@@ -77,6 +77,25 @@ struct rtt_channel_info {
 	uint32_t flags;
 };
 
+/** RTT up-channel statistics, updated by the source on every read. */
+struct rtt_channel_stats {
+	/** Channel buffer size in bytes, as seen by the last read. */
+	uint32_t size;
+	/** Number of bytes fetched by the last read. */
+	uint32_t last_length;
+	/** Total number of bytes fetched from the channel. */
+	uint64_t bytes;
+	/**
+	 * Number of reads that found the channel buffer full. The target may
+	 * have dropped or delayed data in between.
+	 */
+	uint32_t overflows;
+	/** Number of bytes that a sink failed to take. */
+	uint64_t dropped;
+	/** Whether the channel offsets were found invalid, reported only once. */
+	bool invalid;
+};
+
 typedef int (*rtt_sink_read)(unsigned int channel, const uint8_t *buffer,
 		size_t length, void *user_data);
 
@@ -110,7 +129,8 @@ typedef int (*rtt_source_start)(struct target *target,
 typedef int (*rtt_source_stop)(struct target *target, void *user_data);
 typedef int (*rtt_source_read)(struct target *target,
 		const struct rtt_control *ctrl, struct rtt_sink_list **sinks,
-		size_t num_channels, void *user_data);
+		struct rtt_channel_stats *stats, size_t num_channels,
+		void *user_data);
 typedef int (*rtt_source_write)(struct target *target,
 		struct rtt_control *ctrl, unsigned int channel,
 		const uint8_t *buffer, size_t *length, void *user_data);
@@ -194,6 +214,52 @@ int rtt_get_polling_interval(unsigned int *interval);
  */
 int rtt_set_polling_interval(unsigned int interval);
 
+/**
+ * Get the adaptive polling interval bounds.
+ *
+ * @param[out] enabled Whether adaptive polling is enabled.
+ * @param[out] min_interval Lower bound of the polling interval in milliseconds.
+ * @param[out] max_interval Upper bound of the polling interval in milliseconds.
+ *
+ * @returns ERROR_OK on success, an error code on failure.
+ */
+int rtt_get_adaptive_polling(bool *enabled, unsigned int *min_interval,
+		unsigned int *max_interval);
+
+/**
+ * Enable or disable adaptive polling.
+ *
+ * When enabled, the polling interval is halved whenever a poll finds a
+ * channel buffer at least half full and doubled whenever a poll finds no
+ * data, within the given bounds.
+ *
+ * @param[in] enabled Whether to enable adaptive polling.
+ * @param[in] min_interval Lower bound of the polling interval in milliseconds.
+ * @param[in] max_interval Upper bound of the polling interval in milliseconds.
+ *
+ * @returns ERROR_OK on success, an error code on failure.
+ */
+int rtt_set_adaptive_polling(bool enabled, unsigned int min_interval,
+		unsigned int max_interval);
+
+/**
+ * Get the statistics of an up-channel.
+ *
+ * @param[in] channel_index Channel index.
+ *
+ * @returns The channel statistics, or NULL if no sink was ever registered
+ *          for the channel.
+ */
+const struct rtt_channel_stats *rtt_get_channel_stats(unsigned int channel_index);
+
+/**
+ * Account for data of an up-channel that a sink accepted but had to drop.
+ *
+ * @param[in] channel_index Channel index.
+ * @param[in] length Number of bytes dropped.
+ */
+void rtt_add_channel_dropped(unsigned int channel_index, uint64_t length);
+
 /**
  * Get whether RTT is started.
  *
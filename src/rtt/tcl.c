@@ -97,6 +97,76 @@ COMMAND_HANDLER(handle_rtt_polling_interval_command)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(handle_rtt_adaptive_polling_command)
+{
+	int ret;
+	bool enabled;
+	unsigned int min_interval;
+	unsigned int max_interval;
+
+	if (CMD_ARGC == 0) {
+		ret = rtt_get_adaptive_polling(&enabled, &min_interval, &max_interval);
+
+		if (ret != ERROR_OK) {
+			command_print(CMD, "Failed to get adaptive polling");
+			return ret;
+		}
+
+		if (enabled)
+			command_print(CMD, "%u ms - %u ms", min_interval, max_interval);
+		else
+			command_print(CMD, "off");
+
+		return ERROR_OK;
+	} else if (CMD_ARGC == 1) {
+		if (strcmp(CMD_ARGV[0], "off"))
+			return ERROR_COMMAND_SYNTAX_ERROR;
+
+		enabled = false;
+		min_interval = 0;
+		max_interval = 0;
+	} else if (CMD_ARGC == 2) {
+		enabled = true;
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], min_interval);
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[1], max_interval);
+
+		if (!min_interval || min_interval > max_interval) {
+			command_print(CMD, "Invalid polling interval bounds");
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+		}
+	} else {
+		return ERROR_COMMAND_SYNTAX_ERROR;
+	}
+
+	ret = rtt_set_adaptive_polling(enabled, min_interval, max_interval);
+
+	if (ret != ERROR_OK) {
+		command_print(CMD, "Failed to set adaptive polling");
+		return ret;
+	}
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_rtt_statistics_command)
+{
+	if (CMD_ARGC)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	for (unsigned int i = 0; ; i++) {
+		const struct rtt_channel_stats *stats = rtt_get_channel_stats(i);
+
+		if (!stats)
+			break;
+
+		command_print(CMD, "%u: bytes=%" PRIu64 " overflows=%" PRIu32
+			" dropped=%" PRIu64, i, stats->bytes, stats->overflows,
+			stats->dropped);
+	}
+
+	return ERROR_OK;
+}
+
 COMMAND_HANDLER(handle_rtt_channels_command)
 {
 	int ret;
@@ -241,6 +311,20 @@ static const struct command_registration rtt_subcommand_handlers[] = {
 		.help = "show or set polling interval in ms",
 		.usage = "[interval]"
 	},
+	{
+		.name = "adaptive_polling",
+		.handler = handle_rtt_adaptive_polling_command,
+		.mode = COMMAND_EXEC,
+		.help = "show, set or disable adaptive polling interval bounds in ms",
+		.usage = "['off' | min_interval max_interval]"
+	},
+	{
+		.name = "statistics",
+		.handler = handle_rtt_statistics_command,
+		.mode = COMMAND_EXEC,
+		.help = "show up-channel statistics",
+		.usage = ""
+	},
 	{
 		.name = "channels",
 		.handler = handle_rtt_channels_command,
@@ -1301,6 +1301,9 @@ static int gdb_set_registers_packet(struct connection *connection,
 		return ERROR_SERVER_REMOTE_CLOSED;
 	}
 
+	/* the registers of the threads may be read from the core */
+	rtos_reg_cache_invalidate(target);
+
 	retval = target_get_gdb_reg_list(target, &reg_list, &reg_list_size,
 			REG_CLASS_GENERAL);
 	if (retval != ERROR_OK)
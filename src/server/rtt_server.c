@@ -10,6 +10,7 @@
 
 #include <stdint.h>
 #include <rtt/rtt.h>
+#include <target/target.h>
 
 #include "server.h"
 #include "rtt_server.h"
@@ -23,6 +24,12 @@
  * connections.
  */
 
+/* Size of the per-connection output queue. */
+#define RTT_CONNECTION_QUEUE_SIZE	(64 * 1024)
+
+/* Interval in ms to retry sending queued data to a slow client. */
+#define RTT_CONNECTION_FLUSH_INTERVAL	10
+
 struct rtt_service {
 	unsigned int channel;
 };
@@ -30,24 +37,32 @@ struct rtt_service {
 static int read_callback(unsigned int channel, const uint8_t *buffer,
 		size_t length, void *user_data)
 {
-	int ret;
 	struct connection *connection;
-	size_t offset;
+	struct connection_queue *queue;
 
 	connection = (struct connection *)user_data;
-	offset = 0;
-
-	while (offset < length) {
-		ret = connection_write(connection, buffer + offset, length - offset);
+	queue = connection->priv;
 
-		if (ret < 0) {
-			LOG_ERROR("Failed to write data to socket.");
-			return ERROR_FAIL;
-		}
+	uint64_t dropped = queue->dropped;
 
-		offset += ret;
+	/* never block here, a slow client would stall all other channels */
+	if (connection_queue_write(connection, queue, buffer, length) != ERROR_OK) {
+		LOG_ERROR("Failed to write data to socket.");
+		return ERROR_FAIL;
 	}
 
+	/* the queue takes the data even when it has to drop some of it */
+	rtt_add_channel_dropped(channel, queue->dropped - dropped);
+
+	return ERROR_OK;
+}
+
+static int flush_callback(void *user_data)
+{
+	struct connection *connection = user_data;
+
+	connection_queue_flush(connection, connection->priv);
+
 	return ERROR_OK;
 }
 
@@ -55,15 +70,38 @@ static int rtt_new_connection(struct connection *connection)
 {
 	int ret;
 	struct rtt_service *service;
+	struct connection_queue *queue;
 
 	service = connection->service->priv;
 
 	LOG_DEBUG("rtt: New connection for channel %u", service->channel);
 
+	queue = malloc(sizeof(*queue));
+
+	if (!queue)
+		return ERROR_FAIL;
+
+	ret = connection_queue_init(queue, RTT_CONNECTION_QUEUE_SIZE);
+
+	if (ret != ERROR_OK) {
+		free(queue);
+		return ret;
+	}
+
+	connection->priv = queue;
+	socket_nonblock(connection->fd);
+
 	ret = rtt_register_sink(service->channel, &read_callback, connection);
 
-	if (ret != ERROR_OK)
+	if (ret != ERROR_OK) {
+		connection_queue_free(queue);
+		free(queue);
+		connection->priv = NULL;
 		return ret;
+	}
+
+	target_register_timer_callback(&flush_callback,
+		RTT_CONNECTION_FLUSH_INTERVAL, TARGET_TIMER_TYPE_PERIODIC, connection);
 
 	return ERROR_OK;
 }
@@ -71,11 +109,23 @@ static int rtt_new_connection(struct connection *connection)
 static int rtt_connection_closed(struct connection *connection)
 {
 	struct rtt_service *service;
+	struct connection_queue *queue;
 
 	service = (struct rtt_service *)connection->service->priv;
+	queue = connection->priv;
+
+	target_unregister_timer_callback(&flush_callback, connection);
 	rtt_unregister_sink(service->channel, &read_callback, connection);
 
-	LOG_DEBUG("rtt: Connection for channel %u closed", service->channel);
+	if (queue->dropped)
+		LOG_INFO("rtt: %" PRIu64 " bytes of channel %u dropped for a slow client",
+			queue->dropped, service->channel);
+
+	LOG_DEBUG("rtt: Connection for channel %u closed, %zu bytes maximum lag",
+		service->channel, queue->max_count);
+
+	connection_queue_free(queue);
+	free(queue);
 
 	return ERROR_OK;
 }
@@ -747,6 +747,126 @@ int connection_read(struct connection *connection, void *data, int len)
 		return read(connection->fd, data, len);
 }
 
+/* Write without blocking, returns the number of bytes written or -1. */
+static int connection_write_nonblock(struct connection *connection,
+		const void *data, size_t len)
+{
+	int written = connection_write(connection, data, MIN(len, INT_MAX));
+
+	if (written >= 0)
+		return written;
+
+#ifdef _WIN32
+	if (connection->service->type == CONNECTION_TCP &&
+			WSAGetLastError() == WSAEWOULDBLOCK)
+		return 0;
+#endif
+	if (errno == EAGAIN || errno == EWOULDBLOCK)
+		return 0;
+
+	return -1;
+}
+
+int connection_queue_init(struct connection_queue *queue, size_t size)
+{
+	memset(queue, 0, sizeof(*queue));
+
+	queue->buf = malloc(size);
+
+	if (!queue->buf) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	queue->size = size;
+
+	return ERROR_OK;
+}
+
+void connection_queue_free(struct connection_queue *queue)
+{
+	free(queue->buf);
+	queue->buf = NULL;
+	queue->size = 0;
+	queue->count = 0;
+}
+
+int connection_queue_flush(struct connection *connection,
+		struct connection_queue *queue)
+{
+	while (queue->count) {
+		size_t len = MIN(queue->count, queue->size - queue->head);
+		int written = connection_write_nonblock(connection,
+			queue->buf + queue->head, len);
+
+		if (written < 0) {
+			log_socket_error(connection->service->name);
+			return ERROR_SERVER_REMOTE_CLOSED;
+		}
+
+		if (!written)
+			break;
+
+		queue->head = (queue->head + written) % queue->size;
+		queue->count -= written;
+	}
+
+	if (!queue->count)
+		queue->head = 0;
+
+	return ERROR_OK;
+}
+
+int connection_queue_write(struct connection *connection,
+		struct connection_queue *queue, const void *data, size_t len)
+{
+	const uint8_t *buf = data;
+	int retval;
+
+	retval = connection_queue_flush(connection, queue);
+
+	if (retval != ERROR_OK)
+		return retval;
+
+	/* nothing pending, send straight from the caller's buffer */
+	if (!queue->count) {
+		int written = connection_write_nonblock(connection, buf, len);
+
+		if (written < 0) {
+			log_socket_error(connection->service->name);
+			return ERROR_SERVER_REMOTE_CLOSED;
+		}
+
+		buf += written;
+		len -= written;
+	}
+
+	size_t free_space = queue->size - queue->count;
+
+	if (len > free_space) {
+		if (!queue->dropped)
+			LOG_WARNING("'%s' client is too slow, dropping data",
+				connection->service->name);
+
+		queue->dropped += len - free_space;
+		len = free_space;
+	}
+
+	while (len) {
+		size_t tail = (queue->head + queue->count) % queue->size;
+		size_t chunk = MIN(len, queue->size - tail);
+
+		memcpy(queue->buf + tail, buf, chunk);
+		queue->count += chunk;
+		buf += chunk;
+		len -= chunk;
+	}
+
+	queue->max_count = MAX(queue->max_count, queue->count);
+
+	return ERROR_OK;
+}
+
 bool openocd_is_shutdown_pending(void)
 {
 	return shutdown_openocd != CONTINUE_MAIN_LOOP;
@@ -104,6 +104,33 @@ int server_register_commands(struct command_context *context);
 int connection_write(struct connection *connection, const void *data, int len);
 int connection_read(struct connection *connection, void *data, int len);
 
+/**
+ * Bounded output queue of a streaming connection.
+ *
+ * Data that cannot be written to the connection without blocking is kept in
+ * the queue and sent later. Data that does not fit in the queue is dropped,
+ * so a slow client never stalls the server loop.
+ */
+struct connection_queue {
+	uint8_t *buf;
+	size_t size;
+	/** Offset of the oldest queued byte. */
+	size_t head;
+	/** Number of queued bytes. */
+	size_t count;
+	/** Largest number of queued bytes so far. */
+	size_t max_count;
+	/** Number of bytes dropped because the queue was full. */
+	uint64_t dropped;
+};
+
+int connection_queue_init(struct connection_queue *queue, size_t size);
+void connection_queue_free(struct connection_queue *queue);
+int connection_queue_write(struct connection *connection,
+		struct connection_queue *queue, const void *data, size_t len);
+int connection_queue_flush(struct connection *connection,
+		struct connection_queue *queue);
+
 bool openocd_is_shutdown_pending(void);
 
 /**
@@ -297,6 +297,78 @@ static int aarch64_check_state_one(struct target *target,
 	return ERROR_OK;
 }
 
+/*
+ * Drop the PRSR values read ahead for the SMP group, they become stale as
+ * soon as any PE of the group is halted, resumed or stepped.
+ */
+static void aarch64_smp_drop_prsr(struct target *target)
+{
+	struct target_list *head;
+
+	target_to_aarch64(target)->prsr_valid = false;
+
+	if (!target->smp)
+		return;
+
+	foreach_smp_target(head, target->smp_targets)
+		target_to_aarch64(head->target)->prsr_valid = false;
+}
+
+/*
+ * Read PRSR of all examined PEs of the SMP group in one DAP run, so that
+ * polling a cluster costs a single round-trip instead of one per PE.
+ * The other PEs pick up their value on their next poll.
+ */
+static int aarch64_smp_read_prsr(struct target *target)
+{
+	struct adiv5_dap *dap = target_to_armv8(target)->debug_ap->dap;
+	struct target_list *head;
+	int retval = ERROR_OK;
+
+	foreach_smp_target(head, target->smp_targets) {
+		struct target *curr = head->target;
+		struct armv8_common *armv8 = target_to_armv8(curr);
+		struct aarch64_common *aarch64 = target_to_aarch64(curr);
+
+		aarch64->prsr_valid = false;
+		if (curr != target && (!target_was_examined(curr) ||
+				!armv8->debug_ap || armv8->debug_ap->dap != dap))
+			continue;
+
+		retval = mem_ap_read_u32(armv8->debug_ap,
+				armv8->debug_base + CPUV8_DBG_PRSR, &aarch64->prsr);
+		if (retval != ERROR_OK)
+			break;
+		aarch64->prsr_valid = true;
+	}
+
+	if (retval == ERROR_OK)
+		retval = dap_run(dap);
+
+	if (retval != ERROR_OK)
+		aarch64_smp_drop_prsr(target);
+
+	return retval;
+}
+
+static int aarch64_poll_prsr(struct target *target, uint32_t *prsr)
+{
+	struct aarch64_common *aarch64 = target_to_aarch64(target);
+
+	if (!aarch64->prsr_valid && target->smp) {
+		int retval = aarch64_smp_read_prsr(target);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	if (!aarch64->prsr_valid)
+		return aarch64_check_state_one(target, 0, 0, NULL, prsr);
+
+	*prsr = aarch64->prsr;
+	aarch64->prsr_valid = false;
+	return ERROR_OK;
+}
+
 static int aarch64_wait_halt_one(struct target *target)
 {
 	int retval = ERROR_OK;
@@ -506,18 +578,20 @@ static int aarch64_poll(struct target *target)
 {
 	enum target_state prev_target_state;
 	int retval = ERROR_OK;
-	int halted;
+	uint32_t prsr;
 
-	retval = aarch64_check_state_one(target,
-				PRSR_HALT, PRSR_HALT, &halted, NULL);
+	retval = aarch64_poll_prsr(target, &prsr);
 	if (retval != ERROR_OK)
 		return retval;
 
-	if (halted) {
+	if (prsr & PRSR_HALT) {
 		prev_target_state = target->state;
 		if (prev_target_state != TARGET_HALTED) {
 			enum target_debug_reason debug_reason = target->debug_reason;
 
+			/* other PEs may follow through cross-triggers */
+			aarch64_smp_drop_prsr(target);
+
 			/* We have a halting debug event */
 			target->state = TARGET_HALTED;
 			LOG_DEBUG("Target %s halted", target_name(target));
@@ -554,6 +628,7 @@ static int aarch64_halt(struct target *target)
 {
 	struct armv8_common *armv8 = target_to_armv8(target);
 	armv8->last_run_control_op = ARMV8_RUNCONTROL_HALT;
+	aarch64_smp_drop_prsr(target);
 
 	if (target->smp)
 		return aarch64_halt_smp(target, false);
@@ -845,6 +920,7 @@ static int aarch64_resume(struct target *target, int current,
 
 	struct armv8_common *armv8 = target_to_armv8(target);
 	armv8->last_run_control_op = ARMV8_RUNCONTROL_RESUME;
+	aarch64_smp_drop_prsr(target);
 
 	if (target->state != TARGET_HALTED)
 		return ERROR_TARGET_NOT_HALTED;
@@ -1093,6 +1169,7 @@ static int aarch64_step(struct target *target, int current, target_addr_t addres
 	uint32_t edecr;
 
 	armv8->last_run_control_op = ARMV8_RUNCONTROL_STEP;
+	aarch64_smp_drop_prsr(target);
 
 	if (target->state != TARGET_HALTED) {
 		LOG_WARNING("target not halted");
@@ -1928,6 +2005,8 @@ static int aarch64_assert_reset(struct target *target)
 
 	LOG_DEBUG(" ");
 
+	aarch64_smp_drop_prsr(target);
+
 	/* Issue some kind of warm reset. */
 	if (target_has_event_action(target, TARGET_EVENT_RESET_ASSERT))
 		target_handle_event(target, TARGET_EVENT_RESET_ASSERT);
@@ -58,6 +58,11 @@ struct aarch64_common {
 	struct aarch64_brp *wp_list;
 
 	enum aarch64_isrmasking_mode isrmasking_mode;
+
+	/* PRSR read together with the other PEs of the SMP group,
+	 * consumed by the next poll of this PE */
+	bool prsr_valid;
+	uint32_t prsr;
 };
 
 static inline struct aarch64_common *
@@ -30,6 +30,7 @@
 #include <helper/jim-nvp.h>
 #include <helper/list.h>
 #include <helper/log.h>
+#include <helper/time_support.h>
 #include <helper/types.h>
 #include <jtag/interface.h>
 #include <server/server.h>
@@ -101,6 +102,8 @@ struct arm_tpiu_swo_object {
 	/** Synchronous output port width */
 	uint32_t port_width;
 	FILE *file;
+	/** last time the trace destination file was flushed */
+	int64_t file_flush_time;
 	/** output mode */
 	unsigned int pin_protocol;
 	/** Enable formatter */
@@ -121,6 +124,8 @@ struct arm_tpiu_swo_object {
 struct arm_tpiu_swo_connection {
 	struct list_head lh;
 	struct connection *connection;
+	/** trace data not yet sent to a slow client */
+	struct connection_queue queue;
 };
 
 struct arm_tpiu_swo_priv_connection {
@@ -130,6 +135,10 @@ struct arm_tpiu_swo_priv_connection {
 static LIST_HEAD(all_tpiu_swo);
 
 #define ARM_TPIU_SWO_TRACE_BUF_SIZE	4096
+/* per-client queue, about 100ms of trace at 6MB/s */
+#define ARM_TPIU_SWO_CONNECTION_QUEUE_SIZE	(512 * 1024)
+#define ARM_TPIU_SWO_FILE_BUF_SIZE	(64 * 1024)
+#define ARM_TPIU_SWO_FILE_FLUSH_INTERVAL	100
 
 static int arm_tpiu_swo_poll_trace(void *priv)
 {
@@ -139,24 +148,32 @@ static int arm_tpiu_swo_poll_trace(void *priv)
 	struct arm_tpiu_swo_connection *c;
 
 	int retval = adapter_poll_trace(buf, &size);
-	if (retval != ERROR_OK || !size)
+	if (retval != ERROR_OK)
 		return retval;
 
-	target_call_trace_callbacks(/*target*/NULL, size, buf);
+	if (size)
+		target_call_trace_callbacks(/*target*/NULL, size, buf);
 
 	if (obj->file) {
-		if (fwrite(buf, 1, size, obj->file) == size) {
-			fflush(obj->file);
-		} else {
+		if (size && fwrite(buf, 1, size, obj->file) != size) {
 			LOG_ERROR("Error writing to the SWO trace destination file");
 			return ERROR_FAIL;
 		}
+
+		/* the file is fully buffered, let readers see the data from time to time */
+		int64_t now = timeval_ms();
+		if (now - obj->file_flush_time >= ARM_TPIU_SWO_FILE_FLUSH_INTERVAL) {
+			fflush(obj->file);
+			obj->file_flush_time = now;
+		}
 	}
 
+	/* also called without new data, to send what is queued for slow clients */
 	if (obj->out_filename && obj->out_filename[0] == ':')
 		list_for_each_entry(c, &obj->connections, lh)
-			if (connection_write(c->connection, buf, size) != (int)size)
-				LOG_ERROR("Error writing to connection"); /* FIXME: which connection? */
+			if (connection_queue_write(c->connection, &c->queue, buf, size) != ERROR_OK)
+				LOG_ERROR("Error writing to trace connection on port %s",
+					c->connection->service->port);
 
 	return ERROR_OK;
 }
@@ -254,6 +271,12 @@ static int arm_tpiu_swo_service_new_connection(struct connection *connection)
 		LOG_ERROR("Out of memory");
 		return ERROR_FAIL;
 	}
+	if (connection_queue_init(&c->queue, ARM_TPIU_SWO_CONNECTION_QUEUE_SIZE) != ERROR_OK) {
+		free(c);
+		return ERROR_FAIL;
+	}
+	/* never block the trace capture on a slow client */
+	socket_nonblock(connection->fd);
 	c->connection = connection;
 	list_add(&c->lh, &obj->connections);
 	return ERROR_OK;
@@ -283,7 +306,11 @@ static int arm_tpiu_swo_service_connection_closed(struct connection *connection)
 
 	list_for_each_entry_safe(c, tmp, &obj->connections, lh)
 		if (c->connection == connection) {
+			if (c->queue.dropped)
+				LOG_INFO("%" PRIu64 " bytes of trace dropped for a slow client of %s",
+					c->queue.dropped, obj->name);
 			list_del(&c->lh);
+			connection_queue_free(&c->queue);
 			free(c);
 			return ERROR_OK;
 		}
@@ -726,6 +753,8 @@ COMMAND_HANDLER(handle_arm_tpiu_swo_enable)
 				command_print(CMD, "Can't open trace destination file \"%s\"", obj->out_filename);
 				return ERROR_FAIL;
 			}
+			setvbuf(obj->file, NULL, _IOFBF, ARM_TPIU_SWO_FILE_BUF_SIZE);
+			obj->file_flush_time = timeval_ms();
 		}
 
 		retval = adapter_config_trace(true, obj->pin_protocol, obj->port_width,
@@ -134,6 +134,9 @@ static const struct command_registration itm_command_handlers[] = {
 		.help = "Enable or disable all ITM stimulus ports",
 		.usage = "(0|1|on|off)",
 	},
+	{
+		.chain = itm_decode_command_handlers,
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
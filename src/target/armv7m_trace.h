@@ -40,10 +40,16 @@ struct armv7m_trace_config {
 };
 
 extern const struct command_registration armv7m_trace_command_handlers[];
+extern const struct command_registration itm_decode_command_handlers[];
 
 /**
  * Configure hardware accordingly to the current ITM target settings
  */
 int armv7m_trace_itm_config(struct target *target);
 
+/**
+ * Stop the ITM/DWT trace decoder and release its ports and samples
+ */
+int itm_decode_cleanup_all(void);
+
 #endif /* OPENOCD_TARGET_ARMV7M_TRACE_H */
@@ -0,0 +1,659 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/**
+ * @file
+ * Streaming decoder for the ITM/DWT packet protocol received through SWO.
+ *
+ * The decoder is fed by the trace callbacks (see arm_tpiu_swo.c) and
+ * processes the trace stream in place, one byte at a time, so packets split
+ * between two SWO polls are handled naturally. Stimulus port payloads are
+ * forwarded to a file or a TCP server per port, DWT periodic PC samples are
+ * collected in a histogram.
+ *
+ * The TPIU formatter must be disabled, which is the default for SWO.
+ *
+ * Relevant specification: ARMv7-M Architecture Reference Manual, ARM DDI
+ * 0403E, Appendix D4 "Debug ITM and DWT Packet Protocol".
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <helper/command.h>
+#include <helper/list.h>
+#include <helper/log.h>
+#include <server/server.h>
+#include <target/armv7m_trace.h>
+#include <target/target.h>
+
+#define TCP_SERVICE_NAME			"itm_decode"
+
+#define ITM_DECODE_NUM_PORTS		32
+#define ITM_DECODE_PORT_BUF_SIZE	4096
+#define ITM_DECODE_QUEUE_SIZE		(64 * 1024)
+#define ITM_DECODE_FLUSH_INTERVAL	10
+
+/* header byte values and masks */
+#define ITM_SYNC_END				0x80
+#define ITM_SYNC_MIN_ZEROS			5
+#define ITM_OVERFLOW				0x70
+#define ITM_GTS1					0x94
+#define ITM_GTS2					0xb4
+#define ITM_CONTINUATION			0x80
+#define ITM_SOURCE_SIZE_MASK		0x03
+#define ITM_SOURCE_HW				0x04
+
+/* DWT packet discriminator for periodic PC sample packets */
+#define DWT_DISC_PC_SAMPLE			2
+
+enum itm_decode_state {
+	ITM_DECODE_HEADER,
+	/** payload of a stimulus port or hardware source packet */
+	ITM_DECODE_SOURCE,
+	/** payload of a protocol packet, ends with a byte without C bit */
+	ITM_DECODE_CONTINUATION,
+};
+
+struct itm_decode_connection {
+	struct list_head lh;
+	struct connection *connection;
+	struct connection_queue queue;
+};
+
+struct itm_decode_port {
+	/** output file, or NULL */
+	FILE *file;
+	/** TCP port of the server, or NULL */
+	char *tcp_port;
+	struct list_head connections;
+	/** payload collected during the current trace callback */
+	uint8_t buf[ITM_DECODE_PORT_BUF_SIZE];
+	size_t buf_len;
+	uint64_t bytes;
+};
+
+struct itm_decode_service {
+	struct itm_decode_port *port;
+};
+
+struct pc_sample {
+	uint32_t pc;
+	uint32_t count;
+};
+
+static struct {
+	bool enabled;
+
+	enum itm_decode_state state;
+	uint8_t header;
+	unsigned int zeros;
+	unsigned int payload_len;
+	unsigned int payload_pos;
+	uint32_t payload;
+
+	struct itm_decode_port *ports[ITM_DECODE_NUM_PORTS];
+
+	/** open addressing hash table of PC samples, empty slots have count 0 */
+	struct pc_sample *pc_table;
+	size_t pc_table_size;
+	size_t pc_table_used;
+	uint64_t pc_samples;
+	uint64_t sleep_samples;
+
+	uint64_t packets;
+	uint64_t syncs;
+	uint64_t overflows;
+	uint64_t errors;
+} itm_decoder;
+
+static int itm_decode_grow_pc_table(void)
+{
+	size_t size = itm_decoder.pc_table_size ? itm_decoder.pc_table_size * 2 : 1024;
+	struct pc_sample *table = calloc(size, sizeof(*table));
+
+	if (!table) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	for (size_t i = 0; i < itm_decoder.pc_table_size; i++) {
+		struct pc_sample *old = &itm_decoder.pc_table[i];
+
+		if (!old->count)
+			continue;
+
+		size_t slot = (old->pc * 2654435761u) & (size - 1);
+		while (table[slot].count)
+			slot = (slot + 1) & (size - 1);
+		table[slot] = *old;
+	}
+
+	free(itm_decoder.pc_table);
+	itm_decoder.pc_table = table;
+	itm_decoder.pc_table_size = size;
+
+	return ERROR_OK;
+}
+
+static void itm_decode_pc_sample(uint32_t pc)
+{
+	/* keep the load factor below 1/2 */
+	if (2 * (itm_decoder.pc_table_used + 1) > itm_decoder.pc_table_size &&
+			itm_decode_grow_pc_table() != ERROR_OK)
+		return;
+
+	size_t mask = itm_decoder.pc_table_size - 1;
+	size_t slot = (pc * 2654435761u) & mask;
+	struct pc_sample *table = itm_decoder.pc_table;
+
+	while (table[slot].count && table[slot].pc != pc)
+		slot = (slot + 1) & mask;
+
+	if (!table[slot].count) {
+		table[slot].pc = pc;
+		itm_decoder.pc_table_used++;
+	}
+
+	table[slot].count++;
+	itm_decoder.pc_samples++;
+}
+
+static void itm_decode_reset_pc_samples(void)
+{
+	free(itm_decoder.pc_table);
+	itm_decoder.pc_table = NULL;
+	itm_decoder.pc_table_size = 0;
+	itm_decoder.pc_table_used = 0;
+	itm_decoder.pc_samples = 0;
+	itm_decoder.sleep_samples = 0;
+}
+
+static void itm_decode_flush_port(struct itm_decode_port *port)
+{
+	struct itm_decode_connection *c;
+
+	if (!port->buf_len)
+		return;
+
+	if (port->file && fwrite(port->buf, 1, port->buf_len, port->file) != port->buf_len)
+		LOG_ERROR("Error writing ITM stimulus port data to file");
+
+	list_for_each_entry(c, &port->connections, lh)
+		if (connection_queue_write(c->connection, &c->queue, port->buf,
+				port->buf_len) != ERROR_OK)
+			LOG_ERROR("Error writing ITM stimulus port data to port %s",
+				port->tcp_port);
+
+	port->buf_len = 0;
+}
+
+static void itm_decode_stimulus(unsigned int port_num, uint32_t payload,
+		unsigned int len)
+{
+	struct itm_decode_port *port = itm_decoder.ports[port_num];
+
+	if (!port)
+		return;
+
+	if (port->buf_len + len > sizeof(port->buf))
+		itm_decode_flush_port(port);
+
+	/* payload is little endian, as written by the target */
+	for (unsigned int i = 0; i < len; i++)
+		port->buf[port->buf_len++] = payload >> (8 * i);
+
+	port->bytes += len;
+}
+
+static void itm_decode_source_packet(void)
+{
+	unsigned int address = itm_decoder.header >> 3;
+
+	itm_decoder.packets++;
+
+	if (!(itm_decoder.header & ITM_SOURCE_HW)) {
+		itm_decode_stimulus(address, itm_decoder.payload,
+			itm_decoder.payload_len);
+		return;
+	}
+
+	if (address == DWT_DISC_PC_SAMPLE) {
+		/* a single byte payload means the core was sleeping */
+		if (itm_decoder.payload_len == 4)
+			itm_decode_pc_sample(itm_decoder.payload);
+		else
+			itm_decoder.sleep_samples++;
+	}
+}
+
+static void itm_decode_header(uint8_t byte)
+{
+	if (!byte) {
+		itm_decoder.zeros++;
+		return;
+	}
+
+	if (itm_decoder.zeros) {
+		if (byte == ITM_SYNC_END && itm_decoder.zeros >= ITM_SYNC_MIN_ZEROS)
+			itm_decoder.syncs++;
+		else
+			itm_decoder.errors++;
+
+		itm_decoder.zeros = 0;
+
+		if (byte == ITM_SYNC_END)
+			return;
+	}
+
+	itm_decoder.header = byte;
+
+	if (byte & ITM_SOURCE_SIZE_MASK) {
+		unsigned int size = byte & ITM_SOURCE_SIZE_MASK;
+
+		itm_decoder.payload_len = size == 3 ? 4 : size;
+		itm_decoder.payload_pos = 0;
+		itm_decoder.payload = 0;
+		itm_decoder.state = ITM_DECODE_SOURCE;
+		return;
+	}
+
+	if (byte == ITM_OVERFLOW) {
+		itm_decoder.overflows++;
+		return;
+	}
+
+	/* local timestamp format 2 has no payload */
+	if (!(byte & 0x8f) && (byte & 0x70)) {
+		itm_decoder.packets++;
+		return;
+	}
+
+	/*
+	 * Local timestamp format 1 (0b11xx0000), global timestamps and
+	 * extension packets (0bxxxxx1x0) carry continuation payloads.
+	 */
+	if ((byte & 0xcf) == 0xc0 || byte == ITM_GTS1 || byte == ITM_GTS2 ||
+			(byte & 0x0b) == 0x08) {
+		itm_decoder.packets++;
+		if (byte & ITM_CONTINUATION)
+			itm_decoder.state = ITM_DECODE_CONTINUATION;
+		return;
+	}
+
+	itm_decoder.errors++;
+}
+
+static int itm_decode_trace_callback(struct target *target, size_t len,
+		uint8_t *data, void *priv)
+{
+	for (const uint8_t *p = data, *end = data + len; p < end; p++) {
+		switch (itm_decoder.state) {
+		case ITM_DECODE_HEADER:
+			itm_decode_header(*p);
+			break;
+		case ITM_DECODE_SOURCE:
+			itm_decoder.payload |= (uint32_t)*p << (8 * itm_decoder.payload_pos);
+			if (++itm_decoder.payload_pos == itm_decoder.payload_len) {
+				itm_decode_source_packet();
+				itm_decoder.state = ITM_DECODE_HEADER;
+			}
+			break;
+		case ITM_DECODE_CONTINUATION:
+			if (!(*p & ITM_CONTINUATION))
+				itm_decoder.state = ITM_DECODE_HEADER;
+			break;
+		}
+	}
+
+	for (unsigned int i = 0; i < ITM_DECODE_NUM_PORTS; i++)
+		if (itm_decoder.ports[i])
+			itm_decode_flush_port(itm_decoder.ports[i]);
+
+	return ERROR_OK;
+}
+
+/* Send what is queued for slow clients even while no trace arrives. */
+static int itm_decode_flush_callback(void *priv)
+{
+	struct itm_decode_connection *c;
+
+	for (unsigned int i = 0; i < ITM_DECODE_NUM_PORTS; i++) {
+		struct itm_decode_port *port = itm_decoder.ports[i];
+
+		if (!port)
+			continue;
+
+		list_for_each_entry(c, &port->connections, lh)
+			connection_queue_flush(c->connection, &c->queue);
+
+		if (port->file)
+			fflush(port->file);
+	}
+
+	return ERROR_OK;
+}
+
+static int itm_decode_new_connection(struct connection *connection)
+{
+	struct itm_decode_service *service = connection->service->priv;
+	struct itm_decode_connection *c = malloc(sizeof(*c));
+
+	if (!c) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	if (connection_queue_init(&c->queue, ITM_DECODE_QUEUE_SIZE) != ERROR_OK) {
+		free(c);
+		return ERROR_FAIL;
+	}
+
+	socket_nonblock(connection->fd);
+	c->connection = connection;
+	list_add(&c->lh, &service->port->connections);
+
+	return ERROR_OK;
+}
+
+static int itm_decode_input(struct connection *connection)
+{
+	/* read a dummy buffer to check if the connection is still active */
+	long dummy;
+	int bytes_read = connection_read(connection, &dummy, sizeof(dummy));
+
+	if (bytes_read == 0) {
+		return ERROR_SERVER_REMOTE_CLOSED;
+	} else if (bytes_read == -1) {
+		LOG_ERROR("error during read: %s", strerror(errno));
+		return ERROR_SERVER_REMOTE_CLOSED;
+	}
+
+	return ERROR_OK;
+}
+
+static int itm_decode_connection_closed(struct connection *connection)
+{
+	struct itm_decode_service *service = connection->service->priv;
+	struct itm_decode_connection *c, *tmp;
+
+	list_for_each_entry_safe(c, tmp, &service->port->connections, lh)
+		if (c->connection == connection) {
+			list_del(&c->lh);
+			connection_queue_free(&c->queue);
+			free(c);
+			return ERROR_OK;
+		}
+
+	LOG_ERROR("Failed to find connection to close!");
+	return ERROR_FAIL;
+}
+
+static const struct service_driver itm_decode_service_driver = {
+	.name = TCP_SERVICE_NAME,
+	.new_connection_during_keep_alive_handler = NULL,
+	.new_connection_handler = itm_decode_new_connection,
+	.input_handler = itm_decode_input,
+	.connection_closed_handler = itm_decode_connection_closed,
+	.keep_client_alive_handler = NULL,
+};
+
+static void itm_decode_close_port(unsigned int port_num)
+{
+	struct itm_decode_port *port = itm_decoder.ports[port_num];
+
+	if (!port)
+		return;
+
+	itm_decode_flush_port(port);
+
+	if (port->file)
+		fclose(port->file);
+
+	if (port->tcp_port) {
+		remove_service(TCP_SERVICE_NAME, port->tcp_port);
+		free(port->tcp_port);
+	}
+
+	free(port);
+	itm_decoder.ports[port_num] = NULL;
+}
+
+static int itm_decode_open_port(struct command_invocation *cmd,
+		unsigned int port_num, const char *destination)
+{
+	struct itm_decode_port *port = calloc(1, sizeof(*port));
+
+	if (!port) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	INIT_LIST_HEAD(&port->connections);
+
+	if (destination[0] == ':') {
+		struct itm_decode_service *service = malloc(sizeof(*service));
+
+		port->tcp_port = strdup(&destination[1]);
+		if (!service || !port->tcp_port) {
+			LOG_ERROR("Out of memory");
+			free(service);
+			free(port->tcp_port);
+			free(port);
+			return ERROR_FAIL;
+		}
+
+		service->port = port;
+		int retval = add_service(&itm_decode_service_driver, port->tcp_port,
+			CONNECTION_LIMIT_UNLIMITED, service);
+		if (retval != ERROR_OK) {
+			command_print(cmd, "Can't open TCP port %s", port->tcp_port);
+			free(service);
+			free(port->tcp_port);
+			free(port);
+			return retval;
+		}
+	} else {
+		port->file = fopen(destination, "ab");
+		if (!port->file) {
+			command_print(cmd, "Can't open file \"%s\"", destination);
+			free(port);
+			return ERROR_FAIL;
+		}
+	}
+
+	itm_decoder.ports[port_num] = port;
+
+	return ERROR_OK;
+}
+
+static int itm_decode_enable(bool enable)
+{
+	if (enable == itm_decoder.enabled)
+		return ERROR_OK;
+
+	if (enable) {
+		itm_decoder.state = ITM_DECODE_HEADER;
+		itm_decoder.zeros = 0;
+		target_register_trace_callback(itm_decode_trace_callback, NULL);
+		target_register_timer_callback(itm_decode_flush_callback,
+			ITM_DECODE_FLUSH_INTERVAL, TARGET_TIMER_TYPE_PERIODIC, NULL);
+	} else {
+		target_unregister_trace_callback(itm_decode_trace_callback, NULL);
+		target_unregister_timer_callback(itm_decode_flush_callback, NULL);
+	}
+
+	itm_decoder.enabled = enable;
+
+	return ERROR_OK;
+}
+
+int itm_decode_cleanup_all(void)
+{
+	itm_decode_enable(false);
+
+	for (unsigned int i = 0; i < ITM_DECODE_NUM_PORTS; i++)
+		itm_decode_close_port(i);
+
+	itm_decode_reset_pc_samples();
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_itm_decode_enable_command)
+{
+	bool enable;
+
+	if (CMD_ARGC == 0) {
+		command_print(CMD, "%s", itm_decoder.enabled ? "on" : "off");
+		return ERROR_OK;
+	}
+
+	if (CMD_ARGC != 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	COMMAND_PARSE_ON_OFF(CMD_ARGV[0], enable);
+
+	return itm_decode_enable(enable);
+}
+
+COMMAND_HANDLER(handle_itm_decode_port_command)
+{
+	unsigned int port_num;
+
+	if (CMD_ARGC != 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], port_num);
+	if (port_num >= ITM_DECODE_NUM_PORTS) {
+		command_print(CMD, "ITM stimulus port must be less than %d",
+			ITM_DECODE_NUM_PORTS);
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	itm_decode_close_port(port_num);
+
+	if (!strcmp(CMD_ARGV[1], "off"))
+		return ERROR_OK;
+
+	return itm_decode_open_port(CMD, port_num, CMD_ARGV[1]);
+}
+
+static int pc_sample_compare(const void *a, const void *b)
+{
+	const struct pc_sample *sa = a;
+	const struct pc_sample *sb = b;
+
+	if (sa->count != sb->count)
+		return sa->count < sb->count ? 1 : -1;
+
+	return sa->pc < sb->pc ? -1 : sa->pc > sb->pc;
+}
+
+COMMAND_HANDLER(handle_itm_decode_pcsample_command)
+{
+	unsigned int max_entries = 20;
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		if (!strcmp(CMD_ARGV[0], "reset")) {
+			itm_decode_reset_pc_samples();
+			return ERROR_OK;
+		}
+
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], max_entries);
+	}
+
+	struct pc_sample *samples = NULL;
+	size_t num_samples = 0;
+
+	if (itm_decoder.pc_table_used) {
+		samples = malloc(itm_decoder.pc_table_used * sizeof(*samples));
+		if (!samples) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+
+		for (size_t i = 0; i < itm_decoder.pc_table_size; i++)
+			if (itm_decoder.pc_table[i].count)
+				samples[num_samples++] = itm_decoder.pc_table[i];
+
+		qsort(samples, num_samples, sizeof(*samples), pc_sample_compare);
+	}
+
+	uint64_t total = itm_decoder.pc_samples + itm_decoder.sleep_samples;
+	command_print(CMD, "%" PRIu64 " samples, %" PRIu64 " while sleeping, %zu distinct PCs",
+		total, itm_decoder.sleep_samples, num_samples);
+
+	for (size_t i = 0; i < MIN(num_samples, max_entries); i++)
+		command_print(CMD, "0x%08" PRIx32 " %10" PRIu32 " %5.1f%%",
+			samples[i].pc, samples[i].count, 100.0 * samples[i].count / total);
+
+	free(samples);
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_itm_decode_statistics_command)
+{
+	if (CMD_ARGC)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	command_print(CMD, "packets=%" PRIu64 " syncs=%" PRIu64 " overflows=%" PRIu64
+		" errors=%" PRIu64, itm_decoder.packets, itm_decoder.syncs,
+		itm_decoder.overflows, itm_decoder.errors);
+
+	for (unsigned int i = 0; i < ITM_DECODE_NUM_PORTS; i++) {
+		struct itm_decode_port *port = itm_decoder.ports[i];
+
+		if (port)
+			command_print(CMD, "port %u: %" PRIu64 " bytes", i, port->bytes);
+	}
+
+	return ERROR_OK;
+}
+
+static const struct command_registration itm_decode_subcommand_handlers[] = {
+	{
+		.name = "enable",
+		.handler = handle_itm_decode_enable_command,
+		.mode = COMMAND_ANY,
+		.help = "Enable or disable decoding of the SWO trace data",
+		.usage = "[on|off]",
+	},
+	{
+		.name = "port",
+		.handler = handle_itm_decode_port_command,
+		.mode = COMMAND_ANY,
+		.help = "Forward the data of an ITM stimulus port to a file or a TCP port",
+		.usage = "<port> (off|:<tcp_port>|<filename>)",
+	},
+	{
+		.name = "pcsample",
+		.handler = handle_itm_decode_pcsample_command,
+		.mode = COMMAND_ANY,
+		.help = "Display the most frequent DWT PC samples, or reset the histogram",
+		.usage = "[reset|<count>]",
+	},
+	{
+		.name = "statistics",
+		.handler = handle_itm_decode_statistics_command,
+		.mode = COMMAND_ANY,
+		.help = "Display decoder statistics",
+		.usage = "",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
+const struct command_registration itm_decode_command_handlers[] = {
+	{
+		.name = "decode",
+		.mode = COMMAND_ANY,
+		.help = "ITM/DWT trace decoder",
+		.usage = "",
+		.chain = itm_decode_subcommand_handlers,
+	},
+	COMMAND_REGISTRATION_DONE
+};
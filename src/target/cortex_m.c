@@ -2200,7 +2200,7 @@ void cortex_m_deinit_target(struct target *target)
 }
 
 int cortex_m_profiling(struct target *target, uint32_t *samples,
-			      uint32_t max_num_samples, uint32_t *num_samples, uint32_t seconds)
+			      uint32_t max_num_samples, uint32_t *num_samples, uint32_t timeout_ms)
 {
 	struct timeval timeout, now;
 	struct armv7m_common *armv7m = target_to_armv7m(target);
@@ -2213,14 +2213,14 @@ int cortex_m_profiling(struct target *target, uint32_t *samples,
 		return retval;
 	}
 	if (reg_value == 0) {
-		LOG_TARGET_INFO(target, "PCSR sampling not supported on this processor.");
-		return target_profiling_default(target, samples, max_num_samples, num_samples, seconds);
+		LOG_TARGET_DEBUG(target, "PCSR sampling not supported on this processor.");
+		return target_profiling_default(target, samples, max_num_samples, num_samples, timeout_ms);
 	}
 
 	gettimeofday(&timeout, NULL);
-	timeval_add_time(&timeout, seconds, 0);
+	timeval_add_time(&timeout, timeout_ms / 1000, (timeout_ms % 1000) * 1000);
 
-	LOG_TARGET_INFO(target, "Starting Cortex-M profiling. Sampling DWT_PCSR as fast as we can...");
+	LOG_TARGET_DEBUG(target, "Starting Cortex-M profiling. Sampling DWT_PCSR as fast as we can...");
 
 	/* Make sure the target is running */
 	target_poll(target);
@@ -2256,7 +2256,7 @@ int cortex_m_profiling(struct target *target, uint32_t *samples,
 
 		gettimeofday(&now, NULL);
 		if (sample_count >= max_num_samples || timeval_compare(&now, &timeout) > 0) {
-			LOG_TARGET_INFO(target, "Profiling completed. %" PRIu32 " samples.", sample_count);
+			LOG_TARGET_DEBUG(target, "Profiling completed. %" PRIu32 " samples.", sample_count);
 			break;
 		}
 	}
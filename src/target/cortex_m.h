@@ -319,6 +319,6 @@ void cortex_m_enable_breakpoints(struct target *target);
 void cortex_m_enable_watchpoints(struct target *target);
 void cortex_m_deinit_target(struct target *target);
 int cortex_m_profiling(struct target *target, uint32_t *samples,
-	uint32_t max_num_samples, uint32_t *num_samples, uint32_t seconds);
+	uint32_t max_num_samples, uint32_t *num_samples, uint32_t timeout_ms);
 
 #endif /* OPENOCD_TARGET_CORTEX_M_H */
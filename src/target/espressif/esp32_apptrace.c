@@ -47,6 +47,10 @@
 
 #define ESP32_APPTRACE_TGT_STATE_TMO            5000
 #define ESP_APPTRACE_BLOCKS_POOL_SZ             10
+/* the pool grows up to this number of blocks while the target sends a burst of data */
+#define ESP_APPTRACE_BLOCKS_POOL_MAX_SZ         256
+/* longest time spent by one data processor run writing received blocks */
+#define ESP_APPTRACE_PROC_BUDGET_MS             20
 
 struct esp32_apptrace_dest_file_data {
 	int fout;
@@ -335,6 +339,28 @@ static void esp32_apptrace_blocks_pool_cleanup(struct esp32_apptrace_cmd_ctx *ct
 	}
 }
 
+static struct esp32_apptrace_block *esp32_apptrace_block_alloc(struct esp32_apptrace_cmd_ctx *ctx)
+{
+	struct esp32_apptrace_block *block = calloc(1, sizeof(struct esp32_apptrace_block));
+	if (!block)
+		return NULL;
+
+	block->data = malloc(ctx->max_trace_block_sz);
+	if (!block->data) {
+		free(block);
+		return NULL;
+	}
+	INIT_LIST_HEAD(&block->node);
+	ctx->blocks_num++;
+
+	return block;
+}
+
+static bool esp32_apptrace_blocks_pool_can_grow(struct esp32_apptrace_cmd_ctx *ctx)
+{
+	return !list_empty(&ctx->free_trace_blocks) || ctx->blocks_num < ESP_APPTRACE_BLOCKS_POOL_MAX_SZ;
+}
+
 struct esp32_apptrace_block *esp32_apptrace_free_block_get(struct esp32_apptrace_cmd_ctx *ctx)
 {
 	struct esp32_apptrace_block *block = NULL;
@@ -343,6 +369,11 @@ struct esp32_apptrace_block *esp32_apptrace_free_block_get(struct esp32_apptrace
 		/*get first */
 		block = list_first_entry(&ctx->free_trace_blocks, struct esp32_apptrace_block, node);
 		list_del(&block->node);
+	} else if (ctx->blocks_num < ESP_APPTRACE_BLOCKS_POOL_MAX_SZ) {
+		/* blocks are kept in the pool until the end of the tracing session */
+		block = esp32_apptrace_block_alloc(ctx);
+		if (!block)
+			LOG_ERROR("Failed to alloc trace block %" PRIu32 " bytes!", ctx->max_trace_block_sz);
 	}
 
 	return block;
@@ -381,10 +412,20 @@ static int esp32_apptrace_block_free(struct esp32_apptrace_cmd_ctx *ctx, struct
 	return ERROR_OK;
 }
 
+static int esp32_apptrace_process_ready_block(struct esp32_apptrace_cmd_ctx *ctx);
+
 static int esp32_apptrace_wait_tracing_finished(struct esp32_apptrace_cmd_ctx *ctx)
 {
 	int64_t timeout = timeval_ms() + (LOG_LEVEL_IS(LOG_LVL_DEBUG) ? 70000 : 5000);
+	/* the target is not read anymore, write out the blocks received so far */
+	ctx->burst = false;
 	while (!list_empty(&ctx->ready_trace_blocks)) {
+		if (ctx->running) {
+			if (esp32_apptrace_process_ready_block(ctx) != ERROR_OK)
+				return ERROR_FAIL;
+			keep_alive();
+			continue;
+		}
 		alive_sleep(100);
 		if (timeval_ms() >= timeout) {
 			LOG_ERROR("Failed to wait for pended trace blocks!");
@@ -454,20 +495,12 @@ int esp32_apptrace_cmd_ctx_init(struct esp32_apptrace_cmd_ctx *cmd_ctx, struct c
 	INIT_LIST_HEAD(&cmd_ctx->ready_trace_blocks);
 	INIT_LIST_HEAD(&cmd_ctx->free_trace_blocks);
 	for (unsigned int i = 0; i < ESP_APPTRACE_BLOCKS_POOL_SZ; i++) {
-		struct esp32_apptrace_block *block = calloc(1, sizeof(struct esp32_apptrace_block));
+		struct esp32_apptrace_block *block = esp32_apptrace_block_alloc(cmd_ctx);
 		if (!block) {
-			command_print(cmd, "Failed to alloc trace buffer entry!");
-			esp32_apptrace_blocks_pool_cleanup(cmd_ctx);
-			return ERROR_FAIL;
-		}
-		block->data = malloc(cmd_ctx->max_trace_block_sz);
-		if (!block->data) {
-			free(block);
 			command_print(cmd, "Failed to alloc trace buffer %" PRIu32 " bytes!", cmd_ctx->max_trace_block_sz);
 			esp32_apptrace_blocks_pool_cleanup(cmd_ctx);
 			return ERROR_FAIL;
 		}
-		INIT_LIST_HEAD(&block->node);
 		list_add(&block->node, &cmd_ctx->free_trace_blocks);
 	}
 
@@ -628,9 +661,10 @@ static void esp32_apptrace_print_stats(struct esp32_apptrace_cmd_ctx *ctx)
 		cmd_data ? cmd_data->max_len : 0,
 		duration_kbps(&ctx->read_time, ctx->tot_len),
 		duration_kbps(&ctx->read_time, ctx->raw_tot_len));
-	LOG_USER("Data: blocks incomplete %" PRId32 ", lost bytes: %" PRId32,
+	LOG_USER("Data: blocks incomplete %" PRId32 ", lost bytes: %" PRId32 ", pool blocks: %u",
 		ctx->stats.incompl_blocks,
-		ctx->stats.lost_bytes);
+		ctx->stats.lost_bytes,
+		ctx->blocks_num);
 	if (s_time_stats_enable) {
 		LOG_USER("Block read time [%f..%f] ms",
 			1000 * ctx->stats.min_blk_read_time,
@@ -937,13 +971,8 @@ static int esp32_apptrace_handle_trace_block(struct esp32_apptrace_cmd_ctx *ctx,
 	return ERROR_OK;
 }
 
-static int esp32_apptrace_data_processor(void *priv)
+static int esp32_apptrace_process_ready_block(struct esp32_apptrace_cmd_ctx *ctx)
 {
-	struct esp32_apptrace_cmd_ctx *ctx = (struct esp32_apptrace_cmd_ctx *)priv;
-
-	if (!ctx->running)
-		return ERROR_OK;
-
 	struct esp32_apptrace_block *block = esp32_apptrace_ready_block_get(ctx);
 	if (!block)
 		return ERROR_OK;
@@ -964,6 +993,33 @@ static int esp32_apptrace_data_processor(void *priv)
 	return ERROR_OK;
 }
 
+static int esp32_apptrace_data_processor(void *priv)
+{
+	struct esp32_apptrace_cmd_ctx *ctx = (struct esp32_apptrace_cmd_ctx *)priv;
+
+	if (!ctx->running)
+		return ERROR_OK;
+
+	/* While the target sends a burst of data, leave the main loop to
+	 * esp32_apptrace_poll() so that trace blocks are read as fast as the
+	 * target fills them. Received blocks pile up in the pool and are
+	 * written to the destination once the target is idle, or once the pool
+	 * can not grow anymore. */
+	if (ctx->burst && esp32_apptrace_blocks_pool_can_grow(ctx))
+		return ERROR_OK;
+
+	int64_t end = timeval_ms() + ESP_APPTRACE_PROC_BUDGET_MS;
+	while (ctx->running && !list_empty(&ctx->ready_trace_blocks)) {
+		int res = esp32_apptrace_process_ready_block(ctx);
+		if (res != ERROR_OK)
+			return res;
+		if (timeval_ms() >= end)
+			break;
+	}
+
+	return ERROR_OK;
+}
+
 static int esp32_apptrace_check_connection(struct esp32_apptrace_cmd_ctx *ctx)
 {
 	if (!ctx)
@@ -1049,6 +1105,7 @@ static int esp32_apptrace_poll(void *priv)
 	/* LOG_DEBUG("Block %d (%d bytes) on target (%s)!", target_state[0].block_id,
 	 * target_state[0].data_len, target_name(ctx->cpus[0])); */
 	if (fired_target_num == UINT32_MAX) {
+		ctx->burst = false;
 		/* no data has been received, but block could be switched due to the data transferred
 		 * from host to target */
 		if (ctx->cores_num > 1) {
@@ -1081,7 +1138,14 @@ static int esp32_apptrace_poll(void *priv)
 			}
 			ctx->last_blk_id = max_block_id;
 		}
-		if (ctx->stop_tmo != -1.0) {
+		/* received blocks still being written do not count as idle time */
+		if (ctx->stop_tmo != -1.0 && !list_empty(&ctx->ready_trace_blocks)) {
+			if (duration_start(&ctx->idle_time) != 0) {
+				ctx->running = 0;
+				LOG_ERROR("Failed to re-start idle time measure!");
+				return ERROR_FAIL;
+			}
+		} else if (ctx->stop_tmo != -1.0) {
 			if (duration_measure(&ctx->idle_time) != 0) {
 				ctx->running = 0;
 				LOG_ERROR("Failed to measure idle time!");
@@ -1109,6 +1173,13 @@ static int esp32_apptrace_poll(void *priv)
 		}
 	}
 	struct esp32_apptrace_block *block = esp32_apptrace_free_block_get(ctx);
+	if (!block && !list_empty(&ctx->ready_trace_blocks)) {
+		/* the pool is exhausted, make room by writing out the oldest received block */
+		res = esp32_apptrace_process_ready_block(ctx);
+		if (res != ERROR_OK)
+			return res;
+		block = esp32_apptrace_free_block_get(ctx);
+	}
 	if (!block) {
 		ctx->running = 0;
 		LOG_TARGET_ERROR(ctx->cpus[fired_target_num], "Failed to get free block for data!");
@@ -1135,6 +1206,7 @@ static int esp32_apptrace_poll(void *priv)
 	ctx->last_blk_id = target_state[fired_target_num].block_id;
 	block->data_len = target_state[fired_target_num].data_len;
 	ctx->raw_tot_len += block->data_len;
+	ctx->burst = true;
 	if (s_time_stats_enable) {
 		if (duration_measure(&blk_proc_time) != 0) {
 			ctx->running = 0;
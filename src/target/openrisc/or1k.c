@@ -1201,7 +1201,7 @@ static int or1k_checksum_memory(struct target *target, target_addr_t address,
 }
 
 static int or1k_profiling(struct target *target, uint32_t *samples,
-		uint32_t max_num_samples, uint32_t *num_samples, uint32_t seconds)
+		uint32_t max_num_samples, uint32_t *num_samples, uint32_t timeout_ms)
 {
 	struct timeval timeout, now;
 	struct or1k_common *or1k = target_to_or1k(target);
@@ -1209,9 +1209,9 @@ static int or1k_profiling(struct target *target, uint32_t *samples,
 	int retval = ERROR_OK;
 
 	gettimeofday(&timeout, NULL);
-	timeval_add_time(&timeout, seconds, 0);
+	timeval_add_time(&timeout, timeout_ms / 1000, (timeout_ms % 1000) * 1000);
 
-	LOG_INFO("Starting or1k profiling. Sampling npc as fast as we can...");
+	LOG_DEBUG("Starting or1k profiling. Sampling npc as fast as we can...");
 
 	/* Make sure the target is running */
 	target_poll(target);
@@ -1237,7 +1237,7 @@ static int or1k_profiling(struct target *target, uint32_t *samples,
 
 		gettimeofday(&now, NULL);
 		if ((sample_count >= max_num_samples) || timeval_compare(&now, &timeout) > 0) {
-			LOG_INFO("Profiling completed. %" PRIu32 " samples.", sample_count);
+			LOG_DEBUG("Profiling completed. %" PRIu32 " samples.", sample_count);
 			break;
 		}
 	}
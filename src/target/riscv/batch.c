@@ -8,6 +8,8 @@
 #include "debug_defines.h"
 #include "riscv.h"
 
+#include <helper/align.h>
+
 #define get_field(reg, mask) (((reg) & (mask)) / ((mask) & ~((mask) << 1)))
 #define set_field(reg, mask, val) (((reg) & ~(mask)) | (((val) * ((mask) & ~((mask) << 1))) & (mask)))
 
@@ -17,69 +19,128 @@
 
 static void dump_field(int idle, const struct scan_field *field);
 
+/* Offsets of the arrays in the arena of a batch of "scans" scans. */
+struct riscv_batch_layout {
+	size_t fields;
+	size_t bscan_ctxt;
+	size_t read_keys;
+	size_t data_out;
+	size_t data_in;
+	size_t size;
+};
+
+static void batch_layout(struct riscv_batch_layout *layout, size_t scans)
+{
+	/* Keep every array aligned for the largest of its members. */
+	const size_t align = sizeof(uint64_t);
+
+	layout->fields = 0;
+	layout->bscan_ctxt = ALIGN_UP(layout->fields + sizeof(struct scan_field) * scans, align);
+	layout->read_keys = layout->bscan_ctxt;
+	if (bscan_tunnel_ir_width != 0)
+		layout->read_keys = ALIGN_UP(layout->bscan_ctxt +
+				sizeof(riscv_bscan_tunneled_scan_context_t) * scans, align);
+	layout->data_out = ALIGN_UP(layout->read_keys + sizeof(size_t) * scans, align);
+	layout->data_in = layout->data_out + scans * DMI_SCAN_BUF_SIZE;
+	layout->size = layout->data_in + scans * DMI_SCAN_BUF_SIZE;
+}
+
+static struct riscv_batch *batch_pool_get(struct target *target, size_t size)
+{
+	struct riscv_info *r = riscv_info(target);
+	int best = -1;
+
+	/* Prefer a batch whose arena is already large enough. */
+	for (int i = 0; i < RISCV_BATCH_POOL_SIZE; i++) {
+		if (!r->batch_pool[i])
+			continue;
+		if (best < 0 || r->batch_pool[i]->arena_size >= size)
+			best = i;
+		if (r->batch_pool[best]->arena_size >= size)
+			break;
+	}
+
+	if (best < 0)
+		return NULL;
+
+	struct riscv_batch *batch = r->batch_pool[best];
+	r->batch_pool[best] = NULL;
+	return batch;
+}
+
 struct riscv_batch *riscv_batch_alloc(struct target *target, size_t scans, size_t idle)
 {
 	scans += 4;
-	struct riscv_batch *out = calloc(1, sizeof(*out));
-	if (!out)
-		goto error0;
-	out->target = target;
-	out->allocated_scans = scans;
-	out->idle_count = idle;
-	out->data_out = malloc(sizeof(*out->data_out) * (scans) * DMI_SCAN_BUF_SIZE);
-	if (!out->data_out) {
-		LOG_ERROR("Failed to allocate data_out in RISC-V batch.");
-		goto error1;
-	};
-	out->data_in = malloc(sizeof(*out->data_in) * (scans) * DMI_SCAN_BUF_SIZE);
-	if (!out->data_in) {
-		LOG_ERROR("Failed to allocate data_in in RISC-V batch.");
-		goto error2;
-	}
-	out->fields = malloc(sizeof(*out->fields) * (scans));
-	if (!out->fields) {
-		LOG_ERROR("Failed to allocate fields in RISC-V batch.");
-		goto error3;
+	struct riscv_batch_layout layout;
+	batch_layout(&layout, scans);
+
+	struct riscv_batch *out = batch_pool_get(target, layout.size);
+	if (!out) {
+		out = calloc(1, sizeof(*out));
+		if (!out)
+			return NULL;
 	}
-	if (bscan_tunnel_ir_width != 0) {
-		out->bscan_ctxt = malloc(sizeof(*out->bscan_ctxt) * (scans));
-		if (!out->bscan_ctxt) {
-			LOG_ERROR("Failed to allocate bscan_ctxt in RISC-V batch.");
-			goto error4;
+
+	if (out->arena_size < layout.size) {
+		/* Grow to the new high-water mark. */
+		free(out->arena);
+		out->arena = malloc(layout.size);
+		if (!out->arena) {
+			LOG_ERROR("Failed to allocate %zu bytes for RISC-V batch.", layout.size);
+			free(out);
+			return NULL;
 		}
+		out->arena_size = layout.size;
 	}
+
+	uint8_t *arena = out->arena;
+	out->target = target;
+	out->allocated_scans = scans;
+	out->used_scans = 0;
+	out->idle_count = idle;
+	out->fields = (struct scan_field *)(arena + layout.fields);
+	out->bscan_ctxt = NULL;
+	if (bscan_tunnel_ir_width != 0)
+		out->bscan_ctxt = (riscv_bscan_tunneled_scan_context_t *)(arena + layout.bscan_ctxt);
+	out->read_keys = (size_t *)(arena + layout.read_keys);
+	out->read_keys_used = 0;
+	out->data_out = arena + layout.data_out;
+	out->data_in = arena + layout.data_in;
 	out->last_scan = RISCV_SCAN_TYPE_INVALID;
-	out->read_keys = malloc(sizeof(*out->read_keys) * (scans));
-	if (!out->read_keys) {
-		LOG_ERROR("Failed to allocate read_keys in RISC-V batch.");
-		goto error5;
-	}
-	return out;
 
-error5:
-	free(out->bscan_ctxt);
-error4:
-	free(out->fields);
-error3:
-	free(out->data_in);
-error2:
-	free(out->data_out);
-error1:
-	free(out);
-error0:
-	return NULL;
+	return out;
 }
 
 void riscv_batch_free(struct riscv_batch *batch)
 {
-	free(batch->data_in);
-	free(batch->data_out);
-	free(batch->fields);
-	free(batch->bscan_ctxt);
-	free(batch->read_keys);
+	if (!batch)
+		return;
+
+	struct riscv_info *r = riscv_info(batch->target);
+	for (int i = 0; i < RISCV_BATCH_POOL_SIZE; i++) {
+		if (!r->batch_pool[i]) {
+			r->batch_pool[i] = batch;
+			return;
+		}
+	}
+
+	free(batch->arena);
 	free(batch);
 }
 
+void riscv_batch_pool_free(struct target *target)
+{
+	struct riscv_info *r = riscv_info(target);
+
+	for (int i = 0; i < RISCV_BATCH_POOL_SIZE; i++) {
+		if (r->batch_pool[i]) {
+			free(r->batch_pool[i]->arena);
+			free(r->batch_pool[i]);
+			r->batch_pool[i] = NULL;
+		}
+	}
+}
+
 bool riscv_batch_full(struct riscv_batch *batch)
 {
 	return batch->used_scans > (batch->allocated_scans - 4);
@@ -44,14 +44,24 @@ struct riscv_batch {
 	/* The read keys. */
 	size_t *read_keys;
 	size_t read_keys_used;
+
+	/* Single buffer holding all the arrays above.  It is kept when the batch
+	 * goes back to the target's pool, and only grows when a larger batch is
+	 * requested. */
+	void *arena;
+	size_t arena_size;
 };
 
 /* Allocates (or frees) a new scan set.  "scans" is the maximum number of JTAG
  * scans that can be issued to this object, and idle is the number of JTAG idle
- * cycles between every real scan. */
+ * cycles between every real scan.  Freed batches are kept in a small per-target
+ * pool, so that allocating a batch usually costs no memory allocation. */
 struct riscv_batch *riscv_batch_alloc(struct target *target, size_t scans, size_t idle);
 void riscv_batch_free(struct riscv_batch *batch);
 
+/* Releases the batches kept in the target's pool. */
+void riscv_batch_pool_free(struct target *target);
+
 /* Checks to see if this batch is full. */
 bool riscv_batch_full(struct riscv_batch *batch);
 
@@ -18,6 +18,7 @@
 #include "target/target_type.h"
 #include <helper/log.h>
 #include "jtag/jtag.h"
+#include "jtag/adapter.h"
 #include "target/register.h"
 #include "target/breakpoints.h"
 #include "helper/time_support.h"
@@ -39,6 +40,8 @@ static int riscv013_get_register(struct target *target,
 		riscv_reg_t *value, int rid);
 static int riscv013_set_register(struct target *target, int regid, uint64_t value);
 static int riscv013_select_current_hart(struct target *target);
+static int riscv013_halt_summary(struct target *target, unsigned int sweep,
+		bool *halted);
 static int riscv013_halt_prep(struct target *target);
 static int riscv013_halt_go(struct target *target);
 static int riscv013_resume_go(struct target *target);
@@ -144,6 +147,21 @@ typedef struct {
 	int current_hartid;
 	bool hasel_supported;
 
+	/* Last values written to hawindowsel and to each hart array window, so
+	 * that selecting the same group of harts again costs no DMI access. */
+	bool hawindow_valid;
+	uint32_t hawindowsel;
+	uint32_t hawindow[RISCV_MAX_HARTS / 32];
+
+	/* Whether haltsum0 reports the halted harts, checked at examine. */
+	yes_no_maybe_t haltsum0_supported;
+	/* haltsum0, and dmstatus with all harts of the DM selected, read during
+	 * poll sweep number haltsum0_sweep. */
+	uint32_t haltsum0;
+	uint32_t haltsum0_dmstatus;
+	unsigned int haltsum0_sweep;
+	bool haltsum0_valid;
+
 	/* The program buffer stores executable code. 0 is an illegal instruction,
 	 * so we use 0 to mean the cached value is invalid. */
 	uint32_t progbuf_cache[16];
@@ -255,6 +273,7 @@ static dm013_info_t *get_dm(struct target *target)
 		dm->abs_chain_position = abs_chain_position;
 		dm->current_hartid = -1;
 		dm->hart_count = -1;
+		dm->haltsum0_supported = YNM_MAYBE;
 		INIT_LIST_HEAD(&dm->target_list);
 		list_add(&dm->list, &dm_list);
 	}
@@ -1517,6 +1536,93 @@ static int wait_for_authbusy(struct target *target, uint32_t *dmstatus)
 
 /*** OpenOCD target functions. ***/
 
+/* Busy delays stored in a delay profile, see "riscv delay_profile". */
+struct delay_profile {
+	unsigned int adapter_khz;
+	unsigned int dmi_busy_delay;
+	unsigned int ac_busy_delay;
+	unsigned int bus_master_read_delay;
+	unsigned int bus_master_write_delay;
+};
+
+/* Start from the delays learned in a previous session, so that the first
+ * accesses don't have to go through busy responses again. */
+static void delay_profile_load(struct target *target)
+{
+	RISCV_INFO(r);
+	RISCV013_INFO(info);
+
+	if (!r->delay_profile)
+		return;
+
+	FILE *file = fopen(r->delay_profile, "r");
+	if (!file) {
+		LOG_TARGET_DEBUG(target, "No delay profile in %s", r->delay_profile);
+		return;
+	}
+
+	struct delay_profile profile = { 0 };
+	char line[128];
+	while (fgets(line, sizeof(line), file)) {
+		char key[64];
+		unsigned int value;
+		if (line[0] == '#' || sscanf(line, "%63s %u", key, &value) != 2)
+			continue;
+		if (!strcmp(key, "adapter_khz"))
+			profile.adapter_khz = value;
+		else if (!strcmp(key, "dmi_busy_delay"))
+			profile.dmi_busy_delay = value;
+		else if (!strcmp(key, "ac_busy_delay"))
+			profile.ac_busy_delay = value;
+		else if (!strcmp(key, "bus_master_read_delay"))
+			profile.bus_master_read_delay = value;
+		else if (!strcmp(key, "bus_master_write_delay"))
+			profile.bus_master_write_delay = value;
+	}
+	fclose(file);
+
+	/* Delays are counted in TCK cycles, they only apply at the same speed. */
+	if (profile.adapter_khz != adapter_get_speed_khz()) {
+		LOG_TARGET_INFO(target, "Ignoring delay profile %s recorded at %u kHz",
+				r->delay_profile, profile.adapter_khz);
+		return;
+	}
+
+	info->dmi_busy_delay = MAX(info->dmi_busy_delay, profile.dmi_busy_delay);
+	info->ac_busy_delay = MAX(info->ac_busy_delay, profile.ac_busy_delay);
+	info->bus_master_read_delay = MAX(info->bus_master_read_delay,
+			profile.bus_master_read_delay);
+	info->bus_master_write_delay = MAX(info->bus_master_write_delay,
+			profile.bus_master_write_delay);
+	LOG_TARGET_DEBUG(target, "Loaded delay profile %s: dmi_busy_delay=%u, "
+			"ac_busy_delay=%u, bus_master_read_delay=%u, bus_master_write_delay=%u",
+			r->delay_profile, info->dmi_busy_delay, info->ac_busy_delay,
+			info->bus_master_read_delay, info->bus_master_write_delay);
+}
+
+static void delay_profile_save(struct target *target)
+{
+	RISCV_INFO(r);
+	RISCV013_INFO(info);
+
+	if (!r->delay_profile || !target_was_examined(target))
+		return;
+
+	FILE *file = fopen(r->delay_profile, "w");
+	if (!file) {
+		LOG_TARGET_ERROR(target, "Unable to write delay profile %s", r->delay_profile);
+		return;
+	}
+
+	fprintf(file, "# RISC-V busy delays of target %s\n", target_name(target));
+	fprintf(file, "adapter_khz %u\n", adapter_get_speed_khz());
+	fprintf(file, "dmi_busy_delay %u\n", info->dmi_busy_delay);
+	fprintf(file, "ac_busy_delay %u\n", info->ac_busy_delay);
+	fprintf(file, "bus_master_read_delay %u\n", info->bus_master_read_delay);
+	fprintf(file, "bus_master_write_delay %u\n", info->bus_master_write_delay);
+	fclose(file);
+}
+
 static void deinit_target(struct target *target)
 {
 	LOG_DEBUG("riscv_deinit_target()");
@@ -1524,6 +1630,9 @@ static void deinit_target(struct target *target)
 	if (!info)
 		return;
 
+	if (info->version_specific)
+		delay_profile_save(target);
+
 	free(info->version_specific);
 	/* TODO: free register arch_info */
 	info->version_specific = NULL;
@@ -1585,6 +1694,7 @@ static int examine(struct target *target)
 	info->index = target->coreid;
 	info->abits = get_field(dtmcontrol, DTM_DTMCS_ABITS);
 	info->dtmcs_idle = get_field(dtmcontrol, DTM_DTMCS_IDLE);
+	delay_profile_load(target);
 
 	/* Reset the Debug Module. */
 	dm013_info_t *dm = get_dm(target);
@@ -1594,6 +1704,7 @@ static int examine(struct target *target)
 		dmi_write(target, DM_DMCONTROL, 0);
 		dmi_write(target, DM_DMCONTROL, DM_DMCONTROL_DMACTIVE);
 		dm->was_reset = true;
+		dm->hawindow_valid = false;
 	}
 
 	dmi_write(target, DM_DMCONTROL, DM_DMCONTROL_HARTSELLO |
@@ -1723,6 +1834,19 @@ static int examine(struct target *target)
 		}
 	}
 
+	/* haltsum0 is optional, check it reports this hart now that it's halted. */
+	if (dm->haltsum0_supported == YNM_MAYBE) {
+		dm->haltsum0_supported = YNM_NO;
+		if (dm->hart_count <= 32) {
+			uint32_t haltsum0;
+			if (dmi_read(target, &haltsum0, DM_HALTSUM0) != ERROR_OK)
+				return ERROR_FAIL;
+			if (haltsum0 & (1U << info->index))
+				dm->haltsum0_supported = YNM_YES;
+		}
+		LOG_DEBUG("haltsum0_supported=%d", dm->haltsum0_supported);
+	}
+
 	/* Without knowing anything else we can at least mess with the
 		* program buffer. */
 	r->debug_buffer_size = info->progbufsize;
@@ -1886,7 +2010,9 @@ static COMMAND_HELPER(riscv013_print_info, struct target *target)
 	riscv_print_info_line(CMD, "target", "memory.write_while_running128", get_field(info->sbcs, DM_SBCS_SBACCESS128));
 
 	/* Lower level description. */
+	riscv_print_info_line(CMD, "dtm", "dmi_busy_delay", info->dmi_busy_delay);
 	riscv_print_info_line(CMD, "dm", "abits", info->abits);
+	riscv_print_info_line(CMD, "dm", "ac_busy_delay", info->ac_busy_delay);
 	riscv_print_info_line(CMD, "dm", "progbufsize", info->progbufsize);
 	riscv_print_info_line(CMD, "dm", "sbversion", get_field(info->sbcs, DM_SBCS_SBVERSION));
 	riscv_print_info_line(CMD, "dm", "sbasize", get_field(info->sbcs, DM_SBCS_SBASIZE));
@@ -2123,6 +2249,9 @@ static int sba_supports_access(struct target *target, unsigned int size_bytes)
 	}
 }
 
+/* Number of values read by each memory sampling batch. */
+#define RISCV_SAMPLE_BATCH_READS	64
+
 static int sample_memory_bus_v1(struct target *target,
 								struct riscv_sample_buf *buf,
 								const riscv_sample_config_t *config,
@@ -2148,14 +2277,18 @@ static int sample_memory_bus_v1(struct target *target,
 	uint32_t sbaddress1 = 0;
 	bool sbaddress1_valid = false;
 
-	/* How often to read each value in a batch. */
-	const unsigned int repeat = 5;
-
 	unsigned int enabled_count = 0;
 	for (unsigned int i = 0; i < ARRAY_SIZE(config->bucket); i++) {
 		if (config->bucket[i].enabled)
 			enabled_count++;
 	}
+	if (enabled_count == 0)
+		return ERROR_OK;
+
+	/* How often to read each value in a batch.  Large batches share the
+	 * adapter round trip between many reads, which are then issued back to
+	 * back at the DMI rate. */
+	const unsigned int repeat = MAX(5, DIV_ROUND_UP(RISCV_SAMPLE_BATCH_READS, enabled_count));
 
 	while (timeval_ms() < until_ms) {
 		/*
@@ -2210,16 +2343,21 @@ static int sample_memory_bus_v1(struct target *target,
 			}
 		}
 
-		if (buf->used + result_bytes >= buf->size) {
+		/* Each batch is framed by timestamps, 5 bytes each. */
+		if (buf->used + result_bytes + 10 >= buf->size) {
 			riscv_batch_free(batch);
 			break;
 		}
 
 		size_t sbcs_key = riscv_batch_add_dmi_read(batch, DM_SBCS);
 
+		unsigned int batch_start = buf->used;
+		riscv_sample_buf_maybe_add_timestamp(buf, true);
 		int result = batch_run(target, batch);
-		if (result != ERROR_OK)
+		if (result != ERROR_OK) {
+			riscv_batch_free(batch);
 			return result;
+		}
 
 		uint32_t sbcs_read = riscv_batch_get_dmi_read_data(batch, sbcs_key);
 		if (get_field(sbcs_read, DM_SBCS_SBBUSYERROR)) {
@@ -2228,12 +2366,14 @@ static int sample_memory_bus_v1(struct target *target,
 			info->bus_master_read_delay += info->bus_master_read_delay / 10 + 1;
 			dmi_write(target, DM_SBCS, sbcs_read | DM_SBCS_SBBUSYERROR | DM_SBCS_SBERROR);
 			riscv_batch_free(batch);
+			buf->used = batch_start;
 			continue;
 		}
 		if (get_field(sbcs_read, DM_SBCS_SBERROR)) {
 			/* The memory we're sampling was unreadable, somehow. Give up. */
 			dmi_write(target, DM_SBCS, DM_SBCS_SBBUSYERROR | DM_SBCS_SBERROR);
 			riscv_batch_free(batch);
+			buf->used = batch_start;
 			return ERROR_FAIL;
 		}
 
@@ -2253,6 +2393,7 @@ static int sample_memory_bus_v1(struct target *target,
 				}
 			}
 		}
+		riscv_sample_buf_maybe_add_timestamp(buf, false);
 
 		riscv_batch_free(batch);
 	}
@@ -2304,6 +2445,7 @@ static int init_target(struct command_context *cmd_ctx,
 	generic_info->dmi_write = &dmi_write;
 	generic_info->read_memory = read_memory;
 	generic_info->hart_count = &riscv013_hart_count;
+	generic_info->halt_summary = &riscv013_halt_summary;
 	generic_info->data_bits = &riscv013_data_bits;
 	generic_info->print_info = &riscv013_print_info;
 	if (!generic_info->version_specific) {
@@ -4145,6 +4287,30 @@ static int riscv013_select_current_hart(struct target *target)
 	return result;
 }
 
+/* Write the hart array windows, skipping those that already hold the value. */
+static int write_hawindow(struct target *target, dm013_info_t *dm,
+		const uint32_t *hawindow, unsigned int hawindow_count)
+{
+	for (unsigned int i = 0; i < hawindow_count; i++) {
+		if (dm->hawindow_valid && dm->hawindow[i] == hawindow[i])
+			continue;
+		if (!dm->hawindow_valid || dm->hawindowsel != i) {
+			if (dmi_write(target, DM_HAWINDOWSEL, i) != ERROR_OK) {
+				dm->hawindow_valid = false;
+				return ERROR_FAIL;
+			}
+		}
+		if (dmi_write(target, DM_HAWINDOW, hawindow[i]) != ERROR_OK) {
+			dm->hawindow_valid = false;
+			return ERROR_FAIL;
+		}
+		dm->hawindowsel = i;
+		dm->hawindow[i] = hawindow[i];
+	}
+	dm->hawindow_valid = true;
+	return ERROR_OK;
+}
+
 /* Select all harts that were prepped and that are selectable, clearing the
  * prepped flag on the harts that actually were selected. */
 static int select_prepped_harts(struct target *target, bool *use_hasel)
@@ -4188,14 +4354,78 @@ static int select_prepped_harts(struct target *target, bool *use_hasel)
 		return ERROR_OK;
 	}
 
-	for (unsigned i = 0; i < hawindow_count; i++) {
-		if (dmi_write(target, DM_HAWINDOWSEL, i) != ERROR_OK)
+	if (write_hawindow(target, dm, hawindow, hawindow_count) != ERROR_OK)
+		return ERROR_FAIL;
+
+	*use_hasel = true;
+	return ERROR_OK;
+}
+
+/* Read dmstatus with all the harts of the DM selected, so that its any* bits
+ * cover all of them. */
+static int group_dmstatus_read(struct target *target, uint32_t *dmstatus)
+{
+	RISCV_INFO(r);
+	dm013_info_t *dm = get_dm(target);
+	if (!dm)
+		return ERROR_FAIL;
+
+	if (dm->hart_count == 1) {
+		if (riscv013_select_current_hart(target) != ERROR_OK)
 			return ERROR_FAIL;
-		if (dmi_write(target, DM_HAWINDOW, hawindow[i]) != ERROR_OK)
+		return dmstatus_read(target, dmstatus, true);
+	}
+
+	if (!dm->hasel_supported)
+		return ERROR_NOT_IMPLEMENTED;
+
+	/* haltsum0 is only used when all harts are in the first window. */
+	uint32_t hawindow = 0;
+	target_list_t *entry;
+	list_for_each_entry(entry, &dm->target_list, list)
+		hawindow |= 1U << get_info(entry->target)->index;
+	if (write_hawindow(target, dm, &hawindow, 1) != ERROR_OK)
+		return ERROR_FAIL;
+
+	uint32_t dmcontrol = set_hartsel(DM_DMCONTROL_DMACTIVE, r->current_hartid);
+	if (dmi_write(target, DM_DMCONTROL, dmcontrol | DM_DMCONTROL_HASEL) != ERROR_OK)
+		return ERROR_FAIL;
+	dm->current_hartid = -1;
+	if (dmstatus_read(target, dmstatus, true) != ERROR_OK)
+		return ERROR_FAIL;
+	if (dmi_write(target, DM_DMCONTROL, dmcontrol) != ERROR_OK)
+		return ERROR_FAIL;
+	dm->current_hartid = r->current_hartid;
+	return ERROR_OK;
+}
+
+static int riscv013_halt_summary(struct target *target, unsigned int sweep,
+		bool *halted)
+{
+	RISCV013_INFO(info);
+	dm013_info_t *dm = get_dm(target);
+	if (!dm || dm->haltsum0_supported != YNM_YES)
+		return ERROR_NOT_IMPLEMENTED;
+
+	/* All harts of the DM are in the first window, see examine(). */
+	if (!dm->haltsum0_valid || dm->haltsum0_sweep != sweep) {
+		dm->haltsum0_valid = false;
+		int result = group_dmstatus_read(target, &dm->haltsum0_dmstatus);
+		if (result != ERROR_OK)
+			return result;
+		if (dmi_read(target, &dm->haltsum0, DM_HALTSUM0) != ERROR_OK)
 			return ERROR_FAIL;
+		dm->haltsum0_sweep = sweep;
+		dm->haltsum0_valid = true;
 	}
 
-	*use_hasel = true;
+	/* Harts that reset or became unavailable are only reported, and the reset
+	 * acknowledged, when each hart is polled. */
+	if (dm->haltsum0_dmstatus & (DM_DMSTATUS_ANYHAVERESET |
+			DM_DMSTATUS_ANYUNAVAIL | DM_DMSTATUS_ANYNONEXISTENT))
+		return ERROR_FAIL;
+
+	*halted = dm->haltsum0 & (1U << info->index);
 	return ERROR_OK;
 }
 
@@ -4280,9 +4510,90 @@ static int riscv013_on_step(struct target *target)
 	return riscv013_on_step_or_resume(target, true);
 }
 
+/* Read the registers gdb asks for when the hart stops (the GPRs, and dpc for
+ * the PC) in a single batch of abstract commands, and cache them until the
+ * hart resumes.  Any problem just leaves them to be read on demand. */
+static int prefetch_registers(struct target *target)
+{
+	RISCV013_INFO(info);
+
+	if (!target->reg_cache)
+		return ERROR_OK;
+
+	unsigned int xlen = riscv_xlen(target);
+	if (xlen != 32 && xlen != 64)
+		return ERROR_OK;
+
+	enum gdb_regno regs[32];
+	unsigned int count = 0;
+	unsigned int last_gpr = riscv_supports_extension(target, 'E') ?
+		GDB_REGNO_XPR15 : GDB_REGNO_XPR31;
+	for (unsigned int number = GDB_REGNO_ZERO + 1; number <= last_gpr; number++)
+		regs[count++] = number;
+	if (info->abstract_read_csr_supported)
+		regs[count++] = GDB_REGNO_DPC;
+
+	struct riscv_batch *batch = riscv_batch_alloc(target, 3 * count + 1,
+			info->dmi_busy_delay + info->ac_busy_delay);
+	if (!batch)
+		return ERROR_FAIL;
+
+	for (unsigned int i = 0; i < count; i++) {
+		riscv_batch_add_dmi_write(batch, DM_COMMAND,
+				access_register_command(target, regs[i], xlen,
+					AC_ACCESS_REGISTER_TRANSFER));
+		if (xlen > 32)
+			riscv_batch_add_dmi_read(batch, DM_DATA1);
+		riscv_batch_add_dmi_read(batch, DM_DATA0);
+	}
+	size_t abstractcs_key = riscv_batch_add_dmi_read(batch, DM_ABSTRACTCS);
+
+	int result = batch_run(target, batch);
+	if (result != ERROR_OK)
+		goto out;
+
+	for (size_t key = 0; key <= abstractcs_key; key++) {
+		if (riscv_batch_get_dmi_read_op(batch, key) != DMI_STATUS_SUCCESS) {
+			LOG_DEBUG("DMI busy while prefetching registers");
+			increase_dmi_busy_delay(target);
+			riscv013_clear_abstract_error(target);
+			goto out;
+		}
+	}
+
+	uint32_t abstractcs = riscv_batch_get_dmi_read_data(batch, abstractcs_key);
+	info->cmderr = get_field(abstractcs, DM_ABSTRACTCS_CMDERR);
+	if (info->cmderr != CMDERR_NONE) {
+		LOG_DEBUG("prefetching registers failed; abstractcs=0x%x", abstractcs);
+		if (info->cmderr == CMDERR_BUSY)
+			increase_ac_busy_delay(target);
+		riscv013_clear_abstract_error(target);
+		goto out;
+	}
+
+	size_t key = 0;
+	for (unsigned int i = 0; i < count; i++) {
+		uint64_t value = 0;
+		if (xlen > 32)
+			value = (uint64_t)riscv_batch_get_dmi_read_data(batch, key++) << 32;
+		value |= riscv_batch_get_dmi_read_data(batch, key++);
+
+		struct reg *reg = &target->reg_cache->reg_list[regs[i]];
+		buf_set_u64(reg->value, 0, reg->size, value);
+		reg->valid = true;
+	}
+	LOG_DEBUG("[%s] prefetched %d registers", target_name(target), count);
+
+out:
+	riscv_batch_free(batch);
+	return result;
+}
+
 static int riscv013_on_halt(struct target *target)
 {
-	return ERROR_OK;
+	if (riscv_select_current_hart(target) != ERROR_OK)
+		return ERROR_FAIL;
+	return prefetch_registers(target);
 }
 
 static bool riscv013_is_halted(struct target *target)
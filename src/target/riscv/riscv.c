@@ -17,7 +17,9 @@
 #include "jtag/jtag.h"
 #include "target/register.h"
 #include "target/breakpoints.h"
+#include "server/server.h"
 #include "riscv.h"
+#include "batch.h"
 #include "gdb_regs.h"
 #include "rtos/rtos.h"
 #include "debug_defines.h"
@@ -261,22 +263,148 @@ static void riscv_info_init(struct target *target, struct riscv_info *r);
 static void riscv_invalidate_register_cache(struct target *target);
 static int riscv_step_rtos_hart(struct target *target);
 
-static void riscv_sample_buf_maybe_add_timestamp(struct target *target, bool before)
+void riscv_sample_buf_maybe_add_timestamp(struct riscv_sample_buf *buf, bool before)
 {
-	RISCV_INFO(r);
 	uint32_t now = timeval_ms() & 0xffffffff;
-	if (r->sample_buf.used + 5 < r->sample_buf.size) {
+	if (buf->used + 5 < buf->size) {
 		if (before)
-			r->sample_buf.buf[r->sample_buf.used++] = RISCV_SAMPLE_BUF_TIMESTAMP_BEFORE;
+			buf->buf[buf->used++] = RISCV_SAMPLE_BUF_TIMESTAMP_BEFORE;
 		else
-			r->sample_buf.buf[r->sample_buf.used++] = RISCV_SAMPLE_BUF_TIMESTAMP_AFTER;
-		r->sample_buf.buf[r->sample_buf.used++] = now & 0xff;
-		r->sample_buf.buf[r->sample_buf.used++] = (now >> 8) & 0xff;
-		r->sample_buf.buf[r->sample_buf.used++] = (now >> 16) & 0xff;
-		r->sample_buf.buf[r->sample_buf.used++] = (now >> 24) & 0xff;
+			buf->buf[buf->used++] = RISCV_SAMPLE_BUF_TIMESTAMP_AFTER;
+		buf->buf[buf->used++] = now & 0xff;
+		buf->buf[buf->used++] = (now >> 8) & 0xff;
+		buf->buf[buf->used++] = (now >> 16) & 0xff;
+		buf->buf[buf->used++] = (now >> 24) & 0xff;
+	}
+}
+
+#define RISCV_SAMPLE_BUF_SIZE	(1024 * 1024)
+#define RISCV_SAMPLE_SERVICE_NAME	"riscv_memory_sample"
+/* per-client queue, about a second of samples at the maximum DMI rate */
+#define RISCV_SAMPLE_CONNECTION_QUEUE_SIZE	(1024 * 1024)
+
+struct riscv_sample_connection {
+	struct list_head lh;
+	struct connection *connection;
+	/** samples not yet sent to a slow client */
+	struct connection_queue queue;
+};
+
+struct riscv_sample_service {
+	struct target *target;
+};
+
+/* Sends the samples collected so far to the stream, and empties the buffer. */
+static int riscv_sample_stream_write(struct target *target)
+{
+	RISCV_INFO(r);
+	int retval = ERROR_OK;
+
+	if (r->sample_file && r->sample_buf.used) {
+		if (fwrite(r->sample_buf.buf, 1, r->sample_buf.used, r->sample_file) != r->sample_buf.used) {
+			LOG_ERROR("Error writing to the memory sample file");
+			retval = ERROR_FAIL;
+		}
+		fflush(r->sample_file);
 	}
+
+	/* also called without new data, to send what is queued for slow clients */
+	struct riscv_sample_connection *c;
+	list_for_each_entry(c, &r->sample_connections, lh)
+		if (connection_queue_write(c->connection, &c->queue, r->sample_buf.buf,
+					r->sample_buf.used) != ERROR_OK)
+			LOG_ERROR("Error writing to memory sample connection on port %s",
+					c->connection->service->port);
+
+	r->sample_buf.used = 0;
+	return retval;
+}
+
+static void riscv_sample_stream_close(struct target *target)
+{
+	RISCV_INFO(r);
+
+	if (!r->sample_stream)
+		return;
+
+	if (r->sample_file) {
+		fclose(r->sample_file);
+		r->sample_file = NULL;
+	}
+	/* Closes the connections too. */
+	if (r->sample_stream[0] == ':')
+		remove_service(RISCV_SAMPLE_SERVICE_NAME, &r->sample_stream[1]);
+
+	free(r->sample_stream);
+	r->sample_stream = NULL;
+}
+
+static int riscv_sample_service_new_connection(struct connection *connection)
+{
+	struct riscv_sample_service *service = connection->service->priv;
+	struct riscv_info *r = riscv_info(service->target);
+
+	struct riscv_sample_connection *c = malloc(sizeof(*c));
+	if (!c) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	if (connection_queue_init(&c->queue, RISCV_SAMPLE_CONNECTION_QUEUE_SIZE) != ERROR_OK) {
+		free(c);
+		return ERROR_FAIL;
+	}
+	/* never slow down the sampling because of a slow client */
+	socket_nonblock(connection->fd);
+	c->connection = connection;
+	list_add(&c->lh, &r->sample_connections);
+	return ERROR_OK;
+}
+
+static int riscv_sample_service_input(struct connection *connection)
+{
+	/* read a dummy buffer to check if the connection is still active */
+	long dummy;
+	int bytes_read = connection_read(connection, &dummy, sizeof(dummy));
+
+	if (bytes_read == 0) {
+		return ERROR_SERVER_REMOTE_CLOSED;
+	} else if (bytes_read == -1) {
+		LOG_ERROR("error during read: %s", strerror(errno));
+		return ERROR_SERVER_REMOTE_CLOSED;
+	}
+
+	return ERROR_OK;
+}
+
+static int riscv_sample_service_connection_closed(struct connection *connection)
+{
+	struct riscv_sample_service *service = connection->service->priv;
+	struct riscv_info *r = riscv_info(service->target);
+	struct riscv_sample_connection *c, *tmp;
+
+	list_for_each_entry_safe(c, tmp, &r->sample_connections, lh)
+		if (c->connection == connection) {
+			if (c->queue.dropped)
+				LOG_INFO("%" PRIu64 " bytes of memory samples dropped for a slow client of %s",
+						c->queue.dropped, target_name(service->target));
+			list_del(&c->lh);
+			connection_queue_free(&c->queue);
+			free(c);
+			return ERROR_OK;
+		}
+	LOG_ERROR("Failed to find connection to close!");
+	return ERROR_FAIL;
 }
 
+static const struct service_driver riscv_sample_service_driver = {
+	.name = RISCV_SAMPLE_SERVICE_NAME,
+	.new_connection_during_keep_alive_handler = NULL,
+	.new_connection_handler = riscv_sample_service_new_connection,
+	.input_handler = riscv_sample_service_input,
+	.connection_closed_handler = riscv_sample_service_connection_closed,
+	.keep_client_alive_handler = NULL,
+};
+
 static int riscv_resume_go_all_harts(struct target *target);
 
 void select_dmi_via_bscan(struct target *target)
@@ -501,6 +629,11 @@ static void riscv_deinit_target(struct target *target)
 	if (!info)
 		return;
 
+	riscv_batch_pool_free(target);
+
+	riscv_sample_stream_close(target);
+	free(info->sample_buf.buf);
+
 	range_list_t *entry, *tmp;
 	list_for_each_entry_safe(entry, tmp, &info->expose_csr, list) {
 		free(entry->name);
@@ -512,6 +645,7 @@ static void riscv_deinit_target(struct target *target)
 		free(entry);
 	}
 
+	free(info->delay_profile);
 	free(info->reg_names);
 	free(target->arch_info);
 
@@ -1197,6 +1331,8 @@ static int riscv_halt_go_all_harts(struct target *target)
 	}
 
 	riscv_invalidate_register_cache(target);
+	if (r->on_halt)
+		r->on_halt(target);
 
 	return ERROR_OK;
 }
@@ -1567,6 +1703,13 @@ static int riscv_mmu(struct target *target, int *enabled)
 	return ERROR_OK;
 }
 
+static void riscv_tlb_flush(struct target *target)
+{
+	RISCV_INFO(r);
+	for (unsigned int i = 0; i < RISCV_TLB_SIZE; i++)
+		r->tlb[i].valid = false;
+}
+
 static int riscv_address_translate(struct target *target,
 		target_addr_t virtual, target_addr_t *physical)
 {
@@ -1616,6 +1759,16 @@ static int riscv_address_translate(struct target *target,
 		return ERROR_FAIL;
 	}
 
+	target_addr_t virtual_page = virtual >> RISCV_PGSHIFT;
+	struct riscv_tlb_entry *tlb = &r->tlb[virtual_page % RISCV_TLB_SIZE];
+	if (tlb->valid && tlb->satp == satp_value && tlb->virtual_page == virtual_page) {
+		*physical = (tlb->physical_page << RISCV_PGSHIFT) |
+			(virtual & ((1 << RISCV_PGSHIFT) - 1));
+		LOG_DEBUG("0x%" TARGET_PRIxADDR " -> 0x%" TARGET_PRIxADDR " (cached)",
+				virtual, *physical);
+		return ERROR_OK;
+	}
+
 	ppn_value = get_field(satp_value, RISCV_SATP_PPN(xlen));
 	table_address = ppn_value << RISCV_PGSHIFT;
 	i = info->level - 1;
@@ -1671,6 +1824,11 @@ static int riscv_address_translate(struct target *target,
 	LOG_DEBUG("0x%" TARGET_PRIxADDR " -> 0x%" TARGET_PRIxADDR, virtual,
 			*physical);
 
+	tlb->valid = true;
+	tlb->satp = satp_value;
+	tlb->virtual_page = virtual_page;
+	tlb->physical_page = *physical >> RISCV_PGSHIFT;
+
 	return ERROR_OK;
 }
 
@@ -1721,6 +1879,8 @@ static int riscv_write_phys_memory(struct target *target, target_addr_t phys_add
 {
 	if (riscv_select_current_hart(target) != ERROR_OK)
 		return ERROR_FAIL;
+	/* The write may change page tables. */
+	riscv_tlb_flush(target);
 	struct target_type *tt = get_target_type(target);
 	return tt->write_memory(target, phys_address, size, count, buffer);
 }
@@ -1740,6 +1900,9 @@ static int riscv_write_memory(struct target *target, target_addr_t address,
 	if (target->type->virt2phys(target, address, &physical_addr) == ERROR_OK)
 		address = physical_addr;
 
+	/* The write may change page tables. */
+	riscv_tlb_flush(target);
+
 	struct target_type *tt = get_target_type(target);
 	return tt->write_memory(target, address, size, count, buffer);
 }
@@ -1993,7 +2156,7 @@ static int riscv_checksum_memory(struct target *target,
 		uint32_t *checksum)
 {
 	struct working_area *crc_algorithm;
-	struct reg_param reg_params[2];
+	struct reg_param reg_params[6];
 	int retval;
 
 	LOG_DEBUG("address=0x%" TARGET_PRIxADDR "; count=0x%" PRIx32, address, count);
@@ -2050,11 +2213,18 @@ static int riscv_checksum_memory(struct target *target,
 	init_reg_param(&reg_params[1], "a1", xlen, PARAM_OUT);
 	buf_set_u64(reg_params[0].value, 0, xlen, address);
 	buf_set_u64(reg_params[1].value, 0, xlen, count);
+	/* Scratch registers of the algorithm, only passed to be restored after. */
+	init_reg_param(&reg_params[2], "a2", xlen, PARAM_OUT);
+	init_reg_param(&reg_params[3], "a3", xlen, PARAM_OUT);
+	init_reg_param(&reg_params[4], "a4", xlen, PARAM_OUT);
+	init_reg_param(&reg_params[5], "a5", xlen, PARAM_OUT);
+	for (unsigned int i = 2; i < ARRAY_SIZE(reg_params); i++)
+		buf_set_u64(reg_params[i].value, 0, xlen, 0);
 
 	/* 20 second timeout/megabyte */
 	unsigned int timeout = 20000 * (1 + (count / (1024 * 1024)));
 
-	retval = target_run_algorithm(target, 0, NULL, 2, reg_params,
+	retval = target_run_algorithm(target, 0, NULL, ARRAY_SIZE(reg_params), reg_params,
 			crc_algorithm->address,
 			0,	/* Leave exit point unspecified because we don't know. */
 			timeout, NULL);
@@ -2064,8 +2234,8 @@ static int riscv_checksum_memory(struct target *target,
 	else
 		LOG_ERROR("error executing RISC-V CRC algorithm");
 
-	destroy_reg_param(&reg_params[0]);
-	destroy_reg_param(&reg_params[1]);
+	for (unsigned int i = 0; i < ARRAY_SIZE(reg_params); i++)
+		destroy_reg_param(&reg_params[i]);
 
 	target_free_working_area(target, crc_algorithm);
 
@@ -2143,11 +2313,17 @@ static int sample_memory(struct target *target)
 	LOG_DEBUG("buf used/size: %d/%d", r->sample_buf.used, r->sample_buf.size);
 
 	uint64_t start = timeval_ms();
-	riscv_sample_buf_maybe_add_timestamp(target, true);
+	riscv_sample_buf_maybe_add_timestamp(&r->sample_buf, true);
 	int result = ERROR_OK;
 	if (r->sample_memory) {
-		result = r->sample_memory(target, &r->sample_buf, &r->sample_config,
-									  start + TARGET_DEFAULT_POLLING_INTERVAL);
+		do {
+			result = r->sample_memory(target, &r->sample_buf, &r->sample_config,
+										  start + TARGET_DEFAULT_POLLING_INTERVAL);
+			if (result != ERROR_OK || !r->sample_stream)
+				break;
+			/* Make room in the buffer, and keep sampling back to back. */
+			result = riscv_sample_stream_write(target);
+		} while (result == ERROR_OK && timeval_ms() - start < TARGET_DEFAULT_POLLING_INTERVAL);
 		if (result != ERROR_NOT_IMPLEMENTED)
 			goto exit;
 	}
@@ -2169,10 +2345,17 @@ static int sample_memory(struct target *target)
 					goto exit;
 			}
 		}
+		if (r->sample_stream) {
+			result = riscv_sample_stream_write(target);
+			if (result != ERROR_OK)
+				goto exit;
+		}
 	}
 
 exit:
-	riscv_sample_buf_maybe_add_timestamp(target, false);
+	riscv_sample_buf_maybe_add_timestamp(&r->sample_buf, false);
+	if (r->sample_stream && riscv_sample_stream_write(target) != ERROR_OK)
+		result = ERROR_FAIL;
 	if (result != ERROR_OK) {
 		LOG_INFO("Turning off memory sampling because it failed.");
 		r->sample_config.enabled = false;
@@ -2187,12 +2370,22 @@ int riscv_openocd_poll(struct target *target)
 	int halted_hart = -1;
 
 	if (target->smp) {
+		static unsigned int sweep;
 		unsigned should_remain_halted = 0;
 		unsigned should_resume = 0;
 		struct target_list *list;
+		sweep++;
 		foreach_smp_target(list, target->smp_targets) {
 			struct target *t = list->target;
 			struct riscv_info *r = riscv_info(t);
+
+			/* Only select and poll the harts whose state changed. */
+			bool halted;
+			if (r->halt_summary && r->halt_summary(t, sweep, &halted) == ERROR_OK &&
+					((halted && t->state == TARGET_HALTED) ||
+					 (!halted && t->state == TARGET_RUNNING)))
+				continue;
+
 			enum riscv_poll_hart out = riscv_poll_hart(t, r->current_hartid);
 			switch (out) {
 			case RPH_NO_CHANGE:
@@ -2727,6 +2920,191 @@ COMMAND_HANDLER(riscv_reset_delays)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(riscv_delay_profile)
+{
+	if (CMD_ARGC > 1) {
+		LOG_ERROR("Command takes at most one argument");
+		return ERROR_COMMAND_SYNTAX_ERROR;
+	}
+
+	struct target *target = get_current_target(CMD_CTX);
+	RISCV_INFO(r);
+
+	if (CMD_ARGC == 1) {
+		free(r->delay_profile);
+		r->delay_profile = NULL;
+		if (strlen(CMD_ARGV[0]) > 0) {
+			r->delay_profile = strdup(CMD_ARGV[0]);
+			if (!r->delay_profile) {
+				LOG_ERROR("Out of memory");
+				return ERROR_FAIL;
+			}
+		}
+	}
+
+	command_print(CMD, "%s", r->delay_profile ? r->delay_profile : "");
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_memory_sample_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	RISCV_INFO(r);
+
+	if (CMD_ARGC == 0) {
+		command_print(CMD, "Memory sample configuration for %s:", target_name(target));
+		for (unsigned int i = 0; i < ARRAY_SIZE(r->sample_config.bucket); i++) {
+			if (r->sample_config.bucket[i].enabled) {
+				command_print(CMD, "bucket %d; address=0x%" TARGET_PRIxADDR "; size=%d", i,
+						r->sample_config.bucket[i].address,
+						r->sample_config.bucket[i].size_bytes);
+			} else {
+				command_print(CMD, "bucket %d; disabled", i);
+			}
+		}
+		return ERROR_OK;
+	}
+
+	if (CMD_ARGC < 2 || CMD_ARGC > 3)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	uint32_t bucket;
+	COMMAND_PARSE_NUMBER(u32, CMD_ARGV[0], bucket);
+	if (bucket >= ARRAY_SIZE(r->sample_config.bucket)) {
+		LOG_ERROR("Max bucket number is %d.", (unsigned int)ARRAY_SIZE(r->sample_config.bucket) - 1);
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	if (!strcmp(CMD_ARGV[1], "clear")) {
+		r->sample_config.bucket[bucket].enabled = false;
+	} else {
+		COMMAND_PARSE_ADDRESS(CMD_ARGV[1], r->sample_config.bucket[bucket].address);
+
+		if (CMD_ARGC > 2) {
+			COMMAND_PARSE_NUMBER(u32, CMD_ARGV[2], r->sample_config.bucket[bucket].size_bytes);
+			if (r->sample_config.bucket[bucket].size_bytes != 4 &&
+					r->sample_config.bucket[bucket].size_bytes != 8) {
+				LOG_ERROR("Only 4-byte and 8-byte sizes are supported.");
+				return ERROR_COMMAND_ARGUMENT_INVALID;
+			}
+		} else {
+			r->sample_config.bucket[bucket].size_bytes = 4;
+		}
+
+		r->sample_config.bucket[bucket].enabled = true;
+	}
+
+	if (!r->sample_buf.buf) {
+		r->sample_buf.buf = malloc(RISCV_SAMPLE_BUF_SIZE);
+		if (!r->sample_buf.buf) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+		r->sample_buf.size = RISCV_SAMPLE_BUF_SIZE;
+	}
+
+	/* The samples already taken can't be decoded with the new configuration. */
+	r->sample_buf.used = 0;
+
+	r->sample_config.enabled = false;
+	for (unsigned int i = 0; i < ARRAY_SIZE(r->sample_config.bucket); i++)
+		r->sample_config.enabled |= r->sample_config.bucket[i].enabled;
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_memory_sample_stream_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	struct target *target = get_current_target(CMD_CTX);
+	RISCV_INFO(r);
+
+	if (CMD_ARGC == 0) {
+		command_print(CMD, "%s", r->sample_stream ? r->sample_stream : "off");
+		return ERROR_OK;
+	}
+
+	riscv_sample_stream_close(target);
+	if (!strcmp(CMD_ARGV[0], "off"))
+		return ERROR_OK;
+
+	r->sample_stream = strdup(CMD_ARGV[0]);
+	if (!r->sample_stream) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	if (r->sample_stream[0] == ':') {
+		struct riscv_sample_service *service = malloc(sizeof(*service));
+		if (!service) {
+			LOG_ERROR("Out of memory");
+			goto error;
+		}
+		service->target = target;
+		LOG_INFO("starting memory sample server for %s on %s", target_name(target),
+				&r->sample_stream[1]);
+		if (add_service(&riscv_sample_service_driver, &r->sample_stream[1],
+					CONNECTION_LIMIT_UNLIMITED, service) != ERROR_OK) {
+			command_print(CMD, "Can't configure memory sample TCP port %s", &r->sample_stream[1]);
+			free(service);
+			goto error;
+		}
+	} else {
+		r->sample_file = fopen(r->sample_stream, "ab");
+		if (!r->sample_file) {
+			command_print(CMD, "Can't open memory sample file \"%s\"", r->sample_stream);
+			goto error;
+		}
+	}
+
+	/* Don't send samples of an old configuration. */
+	r->sample_buf.used = 0;
+	return ERROR_OK;
+
+error:
+	free(r->sample_stream);
+	r->sample_stream = NULL;
+	return ERROR_FAIL;
+}
+
+COMMAND_HANDLER(handle_dump_sample_buf_command)
+{
+	if (CMD_ARGC > 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	struct target *target = get_current_target(CMD_CTX);
+	RISCV_INFO(r);
+
+	unsigned int i = 0;
+	while (i < r->sample_buf.used) {
+		uint8_t command = r->sample_buf.buf[i++];
+		if (command == RISCV_SAMPLE_BUF_TIMESTAMP_BEFORE ||
+				command == RISCV_SAMPLE_BUF_TIMESTAMP_AFTER) {
+			uint32_t timestamp = buf_get_u32(r->sample_buf.buf + i, 0, 32);
+			i += 4;
+			command_print(CMD, "timestamp %s: %" PRIu32,
+					command == RISCV_SAMPLE_BUF_TIMESTAMP_BEFORE ? "before" : "after",
+					timestamp);
+		} else if (command < ARRAY_SIZE(r->sample_config.bucket) &&
+				r->sample_config.bucket[command].enabled) {
+			unsigned int size = r->sample_config.bucket[command].size_bytes;
+			uint64_t value = buf_get_u64(r->sample_buf.buf + i, 0, 8 * size);
+			i += size;
+			command_print(CMD, "0x%" TARGET_PRIxADDR ": 0x%" PRIx64,
+					r->sample_config.bucket[command].address, value);
+		} else {
+			LOG_ERROR("Found invalid record 0x%x in the sample buffer at offset %d.",
+					command, i - 1);
+			return ERROR_FAIL;
+		}
+	}
+
+	r->sample_buf.used = 0;
+	return ERROR_OK;
+}
+
 COMMAND_HANDLER(riscv_set_ir)
 {
 	if (CMD_ARGC != 2) {
@@ -2993,6 +3371,38 @@ static const struct command_registration riscv_exec_command_handlers[] = {
 		.help = "When on (default), enable translation from virtual address to "
 			"physical address."
 	},
+	{
+		.name = "memory_sample",
+		.handler = handle_memory_sample_command,
+		.mode = COMMAND_ANY,
+		.usage = "[bucket address|clear [size=4]]",
+		.help = "Causes OpenOCD to frequently read size bytes at the given "
+			"address while the target is running."
+	},
+	{
+		.name = "memory_sample_stream",
+		.handler = handle_memory_sample_stream_command,
+		.mode = COMMAND_EXEC,
+		.usage = "[filename|:port|off]",
+		.help = "Stream the memory samples to a file or to the clients of a "
+			"TCP port instead of keeping them in the sample buffer."
+	},
+	{
+		.name = "dump_sample_buf",
+		.handler = handle_dump_sample_buf_command,
+		.mode = COMMAND_ANY,
+		.usage = "",
+		.help = "Print the contents of the sample buffer, and clear it."
+	},
+	{
+		.name = "delay_profile",
+		.handler = riscv_delay_profile,
+		.mode = COMMAND_ANY,
+		.usage = "[filename]",
+		.help = "Set the file the learned busy delays are loaded from when "
+			"the target is examined and saved to at exit. An empty name "
+			"disables it."
+	},
 	{
 		.name = "set_ebreakm",
 		.handler = riscv_set_ebreakm,
@@ -3141,6 +3551,7 @@ static void riscv_info_init(struct target *target, struct riscv_info *r)
 
 	INIT_LIST_HEAD(&r->expose_csr);
 	INIT_LIST_HEAD(&r->expose_custom);
+	INIT_LIST_HEAD(&r->sample_connections);
 }
 
 static int riscv_resume_go_all_harts(struct target *target)
@@ -3231,6 +3642,8 @@ static void riscv_invalidate_register_cache(struct target *target)
 		struct reg *reg = &target->reg_cache->reg_list[i];
 		reg->valid = false;
 	}
+	/* The hart may have changed its page tables while it ran. */
+	riscv_tlb_flush(target);
 }
 
 int riscv_current_hartid(const struct target *target)
@@ -3318,6 +3731,12 @@ int riscv_set_register(struct target *target, enum gdb_regno regid, riscv_reg_t
 	struct reg *reg = &target->reg_cache->reg_list[regid];
 	buf_set_u64(reg->value, 0, reg->size, value);
 
+	if (regid == GDB_REGNO_SATP)
+		riscv_tlb_flush(target);
+	/* The PC is written to dpc. */
+	if (regid == GDB_REGNO_PC)
+		target->reg_cache->reg_list[GDB_REGNO_DPC].valid = false;
+
 	int result = r->set_register(target, regid, value);
 	if (result == ERROR_OK)
 		reg->valid = gdb_regno_cacheable(regid, true);
@@ -3342,6 +3761,10 @@ int riscv_get_register(struct target *target, riscv_reg_t *value,
 		return ERROR_FAIL;
 	}
 
+	/* The PC is read from dpc, which can be cached. */
+	if (regid == GDB_REGNO_PC && target->reg_cache->reg_list[GDB_REGNO_DPC].valid)
+		reg = &target->reg_cache->reg_list[GDB_REGNO_DPC];
+
 	if (reg && reg->valid) {
 		*value = buf_get_u64(reg->value, 0, reg->size);
 		LOG_DEBUG("[%s] %s: %" PRIx64 " (cached)", target_name(target),
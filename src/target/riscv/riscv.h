@@ -81,12 +81,30 @@ typedef struct {
 	} bucket[16];
 } riscv_sample_config_t;
 
+void riscv_sample_buf_maybe_add_timestamp(struct riscv_sample_buf *buf, bool before);
+
 typedef struct {
 	struct list_head list;
 	uint16_t low, high;
 	char *name;
 } range_list_t;
 
+/* Number of virtual pages whose translation is cached, see riscv_address_translate(). */
+#define RISCV_TLB_SIZE 16
+
+struct riscv_tlb_entry {
+	bool valid;
+	/* satp the translation was done with, which includes ASID and root table */
+	riscv_reg_t satp;
+	target_addr_t virtual_page;
+	target_addr_t physical_page;
+};
+
+/* Number of freed batches kept by each target for reuse, see riscv_batch_alloc(). */
+#define RISCV_BATCH_POOL_SIZE 4
+
+struct riscv_batch;
+
 struct riscv_info {
 	unsigned int common_magic;
 
@@ -184,6 +202,10 @@ struct riscv_info {
 
 	/* How many harts are attached to the DM that this target is attached to? */
 	int (*hart_count)(struct target *target);
+	/* Optional.  Tells whether the hart of this target is halted, using a
+	 * summary of all the harts of its DM that is read once per poll sweep.
+	 * Returns ERROR_NOT_IMPLEMENTED when there is no such summary. */
+	int (*halt_summary)(struct target *target, unsigned int sweep, bool *halted);
 	unsigned (*data_bits)(struct target *target);
 
 	COMMAND_HELPER((*print_info), struct target *target);
@@ -226,6 +248,22 @@ struct riscv_info {
 
 	riscv_sample_config_t sample_config;
 	struct riscv_sample_buf sample_buf;
+	/* Where the samples are streamed to while the target runs: a file name,
+	 * or ":port" for a TCP server.  NULL when they are kept in sample_buf. */
+	char *sample_stream;
+	FILE *sample_file;
+	struct list_head sample_connections;
+
+	/* Page translations found by walking the page tables of the hart.  Only
+	 * valid while the hart stays halted and its memory is not written. */
+	struct riscv_tlb_entry tlb[RISCV_TLB_SIZE];
+
+	/* File the learned busy delays are loaded from at examine and saved to
+	 * at exit, see "riscv delay_profile". */
+	char *delay_profile;
+
+	/* Freed batches, kept with their buffers to be handed out again. */
+	struct riscv_batch *batch_pool[RISCV_BATCH_POOL_SIZE];
 };
 
 COMMAND_HELPER(riscv_print_info_line, const char *section, const char *key,
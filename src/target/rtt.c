@@ -18,6 +18,25 @@
 
 #include "target.h"
 
+/* Size of the memory chunks read while searching for the control block. */
+#define RTT_CB_SEARCH_CHUNK_SIZE	(64 * 1024)
+
+/* Maximum number of bytes drained from an up-channel per poll, the rest is
+ * read on the next ones. */
+#define RTT_READ_MAX_SIZE	(64 * 1024)
+
+static void parse_rtt_channel(const uint8_t *buf, target_addr_t address,
+		struct rtt_channel *channel)
+{
+	channel->address = address;
+	channel->name_addr = buf_get_u32(buf + 0, 0, 32);
+	channel->buffer_addr = buf_get_u32(buf + 4, 0, 32);
+	channel->size = buf_get_u32(buf + 8, 0, 32);
+	channel->write_pos = buf_get_u32(buf + 12, 0, 32);
+	channel->read_pos = buf_get_u32(buf + 16, 0, 32);
+	channel->flags = buf_get_u32(buf + 20, 0, 32);
+}
+
 static int read_rtt_channel(struct target *target,
 		const struct rtt_control *ctrl, unsigned int channel_index,
 		enum rtt_channel_type type, struct rtt_channel *channel)
@@ -36,13 +55,7 @@ static int read_rtt_channel(struct target *target,
 	if (ret != ERROR_OK)
 		return ret;
 
-	channel->address = address;
-	channel->name_addr = buf_get_u32(buf + 0, 0, 32);
-	channel->buffer_addr = buf_get_u32(buf + 4, 0, 32);
-	channel->size = buf_get_u32(buf + 8, 0, 32);
-	channel->write_pos = buf_get_u32(buf + 12, 0, 32);
-	channel->read_pos = buf_get_u32(buf + 16, 0, 32);
-	channel->flags = buf_get_u32(buf + 20, 0, 32);
+	parse_rtt_channel(buf, address, channel);
 
 	return ERROR_OK;
 }
@@ -238,48 +251,81 @@ int target_rtt_read_control_block(struct target *target,
 	return ERROR_OK;
 }
 
+/* Search for the first occurrence of the ID in the buffer. */
+static const uint8_t *find_id(const uint8_t *buf, size_t buf_size,
+		const char *id, size_t id_length)
+{
+	const uint8_t *end = buf + buf_size;
+
+	while ((size_t)(end - buf) >= id_length) {
+		const uint8_t *p = memchr(buf, id[0], end - buf - id_length + 1);
+
+		if (!p)
+			return NULL;
+
+		if (!memcmp(p + 1, id + 1, id_length - 1))
+			return p;
+
+		buf = p + 1;
+	}
+
+	return NULL;
+}
+
 int target_rtt_find_control_block(struct target *target,
 		target_addr_t *address, size_t size, const char *id, bool *found,
 		void *user_data)
 {
-	target_addr_t address_end = *address + size;
-	uint8_t buf[1024];
+	const target_addr_t address_end = *address + size;
+	const size_t id_length = strlen(id);
+	uint8_t *buf;
+	/* Bytes at the start of the buffer kept from the previous chunk. */
+	size_t overlap = 0;
+	int ret = ERROR_OK;
 
 	*found = false;
 
-	size_t id_matched_length = 0;
-	const size_t id_length = strlen(id);
+	if (!id_length || size < id_length)
+		return ERROR_OK;
+
+	buf = malloc(RTT_CB_SEARCH_CHUNK_SIZE);
+
+	if (!buf)
+		return ERROR_FAIL;
 
 	LOG_INFO("rtt: Searching for control block '%s'", id);
 
-	for (target_addr_t addr = *address; addr < address_end; addr += sizeof(buf)) {
-		int ret;
+	for (target_addr_t addr = *address; addr < address_end; ) {
+		const size_t read_size = MIN(RTT_CB_SEARCH_CHUNK_SIZE - overlap,
+			address_end - addr);
 
-		const size_t buf_size = MIN(sizeof(buf), address_end - addr);
-		ret = target_read_buffer(target, addr, buf_size, buf);
+		ret = target_read_buffer(target, addr, read_size, buf + overlap);
 
 		if (ret != ERROR_OK)
-			return ret;
+			goto out;
 
-		for (size_t buf_off = 0; buf_off < buf_size; buf_off++) {
-			if (id_matched_length > 0 &&
-			    buf[buf_off] != id[id_matched_length]) {
-				/* Start from beginning */
-				id_matched_length = 0;
-			}
-
-			if (buf[buf_off] == id[id_matched_length])
-				id_matched_length++;
-
-			if (id_matched_length == id_length) {
-				*address = addr + buf_off + 1 - id_length;
-				*found = true;
-				return ERROR_OK;
-			}
+		const size_t buf_size = overlap + read_size;
+		const uint8_t *match = find_id(buf, buf_size, id, id_length);
+
+		if (match) {
+			*address = addr - overlap + (match - buf);
+			*found = true;
+			goto out;
 		}
+
+		/*
+		 * Keep the end of the chunk so that an ID which spans two chunks is
+		 * found on the next iteration.
+		 */
+		overlap = MIN(id_length - 1, buf_size);
+		memmove(buf, buf + buf_size - overlap, overlap);
+		addr += read_size;
 	}
 
-	return ERROR_OK;
+out:
+	free(buf);
+
+	return ret;
 }
 
 int target_rtt_read_channel_info(struct target *target,
@@ -363,50 +409,155 @@ static int read_from_channel(struct target *target,
 	return ERROR_OK;
 }
 
+/* Number of bytes the target has written into an up-channel but which were not
+ * read yet. */
+static uint32_t channel_pending_length(const struct rtt_channel *channel)
+{
+	uint32_t length;
+
+	if (channel->read_pos <= channel->write_pos)
+		length = channel->write_pos - channel->read_pos;
+	else
+		length = channel->size - channel->read_pos + channel->write_pos;
+
+	/* the target always keeps one byte of the ring buffer free */
+	return MIN(length, channel->size - 1);
+}
+
+/* Whether the offsets of an up-channel are within its buffer. A stale or
+ * corrupt descriptor would make it look like gigabytes are pending. */
+static bool channel_offsets_are_valid(const struct rtt_channel *channel)
+{
+	return channel->read_pos < channel->size && channel->write_pos < channel->size;
+}
+
 int target_rtt_read_callback(struct target *target,
 		const struct rtt_control *ctrl, struct rtt_sink_list **sinks,
-		size_t num_channels, void *user_data)
+		struct rtt_channel_stats *stats, size_t num_channels, void *user_data)
 {
+	int ret;
+	struct rtt_channel *channels;
+	uint8_t *descriptors;
+	uint8_t *buffer = NULL;
+	size_t buffer_size = 0;
+
+	for (size_t i = 0; i < num_channels; i++)
+		stats[i].last_length = 0;
+
 	num_channels = MIN(num_channels, ctrl->num_up_channels);
 
+	/* only the descriptors up to the last channel with a sink are needed */
+	while (num_channels > 0 && !sinks[num_channels - 1])
+		num_channels--;
+
+	if (!num_channels)
+		return ERROR_OK;
+
+	channels = calloc(num_channels, sizeof(*channels));
+	descriptors = malloc(num_channels * RTT_CHANNEL_SIZE);
+
+	if (!channels || !descriptors) {
+		LOG_ERROR("rtt: Failed to allocate channel descriptors");
+		ret = ERROR_FAIL;
+		goto out;
+	}
+
+	/* The up-channel descriptors are contiguous, read all of them at once
+	 * rather than one round-trip per channel. */
+	ret = target_read_buffer(target, ctrl->address + RTT_CB_SIZE,
+		num_channels * RTT_CHANNEL_SIZE, descriptors);
+
+	if (ret != ERROR_OK) {
+		LOG_ERROR("rtt: Failed to read up-channel descriptions");
+		goto out;
+	}
+
 	for (size_t i = 0; i < num_channels; i++) {
-		int ret;
-		struct rtt_channel channel;
-		uint8_t buffer[1024];
-		size_t length;
+		parse_rtt_channel(descriptors + i * RTT_CHANNEL_SIZE,
+			ctrl->address + RTT_CB_SIZE + i * RTT_CHANNEL_SIZE, &channels[i]);
 
 		if (!sinks[i])
 			continue;
 
-		ret = read_rtt_channel(target, ctrl, i, RTT_CHANNEL_TYPE_UP,
-			&channel);
-
-		if (ret != ERROR_OK) {
-			LOG_ERROR("rtt: Failed to read up-channel %zu description", i);
-			return ret;
-		}
-
-		if (!channel_is_active(&channel)) {
+		if (!channel_is_active(&channels[i])) {
 			LOG_WARNING("rtt: Up-channel %zu is not active", i);
 			continue;
 		}
 
-		if (channel.size < RTT_CHANNEL_BUFFER_MIN_SIZE) {
+		if (channels[i].size < RTT_CHANNEL_BUFFER_MIN_SIZE) {
 			LOG_WARNING("rtt: Up-channel %zu is not large enough", i);
 			continue;
 		}
 
-		length = sizeof(buffer);
-		ret = read_from_channel(target, &channel, buffer, &length);
+		if (!channel_offsets_are_valid(&channels[i])) {
+			if (!stats[i].invalid)
+				LOG_WARNING("rtt: Up-channel %zu has invalid read/write offsets", i);
+			stats[i].invalid = true;
+			continue;
+		}
+		stats[i].invalid = false;
+
+		uint32_t pending = channel_pending_length(&channels[i]);
+
+		stats[i].size = channels[i].size;
+		if (pending >= channels[i].size - 1)
+			stats[i].overflows++;
+
+		buffer_size = MAX(buffer_size, pending);
+	}
+
+	/* the size of a corrupt descriptor can still be huge */
+	buffer_size = MIN(buffer_size, RTT_READ_MAX_SIZE);
+
+	if (!buffer_size)
+		goto out;
+
+	/* large enough to drain any of the channels in a single pass, up to
+	 * RTT_READ_MAX_SIZE */
+	buffer = malloc(buffer_size);
+
+	if (!buffer) {
+		LOG_ERROR("rtt: Failed to allocate read buffer");
+		ret = ERROR_FAIL;
+		goto out;
+	}
+
+	for (size_t i = 0; i < num_channels; i++) {
+		size_t length;
+
+		if (!sinks[i] || !channel_is_active(&channels[i]) ||
+				channels[i].size < RTT_CHANNEL_BUFFER_MIN_SIZE ||
+				!channel_offsets_are_valid(&channels[i]))
+			continue;
+
+		length = buffer_size;
+		ret = read_from_channel(target, &channels[i], buffer, &length);
 
 		if (ret != ERROR_OK) {
 			LOG_ERROR("rtt: Failed to read from up-channel %zu", i);
-			return ret;
+			goto out;
 		}
 
-		for (struct rtt_sink_list *sink = sinks[i]; sink; sink = sink->next)
-			sink->read(i, buffer, length, sink->user_data);
+		if (!length)
+			continue;
+
+		stats[i].last_length = length;
+		stats[i].bytes += length;
+
+		/* count the data once even if several sinks failed to take it */
+		bool failed = false;
+		for (struct rtt_sink_list *sink = sinks[i]; sink; sink = sink->next) {
+			if (sink->read(i, buffer, length, sink->user_data) != ERROR_OK)
+				failed = true;
+		}
+		if (failed)
+			stats[i].dropped += length;
 	}
 
-	return ERROR_OK;
+out:
+	free(buffer);
+	free(descriptors);
+	free(channels);
+
+	return ret;
 }
@@ -39,6 +39,7 @@
 
 #include <helper/binarybuffer.h>
 #include <helper/log.h>
+#include <helper/time_support.h>
 #include <server/gdb_server.h>
 #include <sys/stat.h>
 
@@ -93,6 +94,19 @@ static int semihosting_common_fileio_info(struct target *target,
 static int semihosting_common_fileio_end(struct target *target, int result,
 	int fileio_errno, bool ctrl_c);
 
+static void semihosting_console_flush(struct semihosting *semihosting);
+
+static int semihosting_event_callback(struct target *target,
+	enum target_event event, void *priv)
+{
+	/* don't keep a partial line, like a prompt, while the target is stopped */
+	if (target == priv && target->semihosting &&
+			(event == TARGET_EVENT_HALTED || event == TARGET_EVENT_RESUMED))
+		semihosting_console_flush(target->semihosting);
+
+	return ERROR_OK;
+}
+
 /**
  * Initialize common semihosting support.
  *
@@ -130,6 +144,9 @@ int semihosting_common_init(struct target *target, void *setup,
 	semihosting->hit_fileio = false;
 	semihosting->is_resumable = false;
 	semihosting->has_resumable_exit = false;
+	semihosting->is_buffered = false;
+	semihosting->console_len = 0;
+	memset(semihosting->stats, 0, sizeof(semihosting->stats));
 	semihosting->word_size_bytes = 0;
 	semihosting->op = -1;
 	semihosting->param = 0;
@@ -147,12 +164,31 @@ int semihosting_common_init(struct target *target, void *setup,
 
 	target->semihosting = semihosting;
 
+	target_register_event_callback(semihosting_event_callback, target);
+
 	target->type->get_gdb_fileio_info = semihosting_common_fileio_info;
 	target->type->gdb_fileio_end = semihosting_common_fileio_end;
 
 	return ERROR_OK;
 }
 
+/**
+ * Free the semihosting state of a target.
+ *
+ * @param target Pointer to the target.
+ */
+void semihosting_common_free(struct target *target)
+{
+	if (!target->semihosting)
+		return;
+
+	target_unregister_event_callback(semihosting_event_callback, target);
+
+	free(target->semihosting->basedir);
+	free(target->semihosting);
+	target->semihosting = NULL;
+}
+
 struct semihosting_tcp_service {
 	struct semihosting *semihosting;
 	char *name;
@@ -255,13 +291,83 @@ static ssize_t semihosting_redirect_read(struct semihosting *semihosting, void *
 	return retval;
 }
 
-static inline int semihosting_putchar(struct semihosting *semihosting, int fd, int c)
+static void semihosting_console_output(struct semihosting *semihosting,
+	uint8_t *buf, size_t size)
 {
-	if (semihosting_is_redirected(semihosting, fd))
-		return semihosting_redirect_write(semihosting, &c, 1);
+	/* debug operations are redirected when CFG is either DEBUG or ALL */
+	if (semihosting->redirect_cfg == SEMIHOSTING_REDIRECT_CFG_DEBUG ||
+			semihosting->redirect_cfg == SEMIHOSTING_REDIRECT_CFG_ALL) {
+		semihosting_redirect_write(semihosting, buf, size);
+		return;
+	}
+
+	/* default output, same stream as putchar() */
+	fwrite(buf, 1, size, stdout);
+}
+
+static void semihosting_console_flush(struct semihosting *semihosting)
+{
+	if (semihosting->console_len == 0)
+		return;
+
+	semihosting_console_output(semihosting, semihosting->console_buf,
+		semihosting->console_len);
+	semihosting->console_len = 0;
+}
+
+/**
+ * Write WRITEC and WRITE0 output to the debug channel, coalesced in the
+ * console buffer when semihosting buffering is enabled.
+ */
+static void semihosting_console_write(struct semihosting *semihosting,
+	uint8_t *buf, size_t size)
+{
+	if (!semihosting->is_buffered) {
+		semihosting_console_output(semihosting, buf, size);
+		return;
+	}
+
+	while (size > 0) {
+		size_t len = MIN(size, SEMIHOSTING_CONSOLE_BUF_SIZE - semihosting->console_len);
+
+		memcpy(semihosting->console_buf + semihosting->console_len, buf, len);
+		semihosting->console_len += len;
+
+		if (semihosting->console_len == SEMIHOSTING_CONSOLE_BUF_SIZE ||
+				memchr(buf, '\n', len))
+			semihosting_console_flush(semihosting);
+
+		buf += len;
+		size -= len;
+	}
+}
 
-	/* default putchar */
-	return putchar(c);
+/**
+ * Strings of WRITE0 are read in chunks that never cross a multiple of
+ * this size, so that no access goes beyond the MPU region or the page
+ * holding the terminating null character.
+ */
+#define SEMIHOSTING_STRING_CHUNK 32
+
+/**
+ * Read the part of a null-terminated string up to the next chunk boundary.
+ * @param len set to the number of characters read, terminator excluded
+ * @param end set when the terminator was found
+ */
+static int semihosting_read_string_chunk(struct target *target, uint64_t addr,
+	uint8_t *buf, size_t *len, bool *end)
+{
+	size_t size = SEMIHOSTING_STRING_CHUNK - (addr % SEMIHOSTING_STRING_CHUNK);
+
+	int retval = target_read_buffer(target, addr, size, buf);
+	if (retval != ERROR_OK)
+		return retval;
+
+	uint8_t *nul = memchr(buf, '\0', size);
+	*end = nul;
+	*len = nul ? (size_t)(nul - buf) : size;
+
+	return ERROR_OK;
 }
 
 static inline ssize_t semihosting_read(struct semihosting *semihosting, int fd, void *buf, int size)
@@ -358,6 +464,27 @@ const char *semihosting_opcode_to_str(const uint64_t opcode)
 	}
 }
 
+static int semihosting_stats_index(int op)
+{
+	if (op >= 0 && op < SEMIHOSTING_ARM_RESERVED_START)
+		return op;
+
+	if (op >= SEMIHOSTING_USER_CMD_0X100 && op <= SEMIHOSTING_USER_CMD_0X107)
+		return SEMIHOSTING_ARM_RESERVED_START + op - SEMIHOSTING_USER_CMD_0X100;
+
+	return -1;
+}
+
+static int semihosting_stats_op(int index)
+{
+	if (index < SEMIHOSTING_ARM_RESERVED_START)
+		return index;
+
+	return SEMIHOSTING_USER_CMD_0X100 + index - SEMIHOSTING_ARM_RESERVED_START;
+}
+
+static int semihosting_common_op(struct target *target);
+
 /**
  * Portable implementation of ARM semihosting calls.
  * Performs the currently pending semihosting operation
@@ -371,6 +498,33 @@ int semihosting_common(struct target *target)
 		return ERROR_OK;
 	}
 
+	int op = semihosting->op;
+	struct duration op_time;
+	duration_start(&op_time);
+
+	/* keep the console output in order with any other operation */
+	if (op != SEMIHOSTING_SYS_WRITEC && op != SEMIHOSTING_SYS_WRITE0)
+		semihosting_console_flush(semihosting);
+
+	int retval = semihosting_common_op(target);
+
+	int index = semihosting_stats_index(op);
+	if (index >= 0 && duration_measure(&op_time) == ERROR_OK) {
+		struct semihosting_op_stats *stats = &semihosting->stats[index];
+		float elapsed = duration_elapsed(&op_time);
+
+		stats->count++;
+		stats->total += elapsed;
+		if (elapsed > stats->max)
+			stats->max = elapsed;
+	}
+
+	return retval;
+}
+
+static int semihosting_common_op(struct target *target)
+{
+	struct semihosting *semihosting = target->semihosting;
 	struct gdb_fileio_info *fileio_info = target->fileio_info;
 
 	/*
@@ -1432,7 +1586,7 @@ int semihosting_common(struct target *target)
 				retval = target_read_memory(target, addr, 1, 1, &c);
 				if (retval != ERROR_OK)
 					return retval;
-				semihosting_putchar(semihosting, semihosting->stdout_fd, c);
+				semihosting_console_write(semihosting, &c, 1);
 				semihosting->result = 0;
 			}
 			break;
@@ -1450,35 +1604,33 @@ int semihosting_common(struct target *target)
 			 * Return
 			 * None. The RETURN REGISTER is corrupted.
 			 */
-			if (semihosting->is_fileio) {
-				size_t count = 0;
+			{
+				uint8_t chunk[SEMIHOSTING_STRING_CHUNK];
 				uint64_t addr = semihosting->param;
-				for (;; addr++) {
-					unsigned char c;
-					retval = target_read_memory(target, addr, 1, 1, &c);
+				size_t count = 0;
+				bool end = false;
+
+				while (!end) {
+					size_t len;
+					retval = semihosting_read_string_chunk(target, addr,
+							chunk, &len, &end);
 					if (retval != ERROR_OK)
 						return retval;
-					if (c == '\0')
-						break;
-					count++;
+					if (!semihosting->is_fileio)
+						semihosting_console_write(semihosting, chunk, len);
+					addr += len;
+					count += len;
+				}
+
+				if (semihosting->is_fileio) {
+					semihosting->hit_fileio = true;
+					fileio_info->identifier = "write";
+					fileio_info->param_1 = 1;
+					fileio_info->param_2 = semihosting->param;
+					fileio_info->param_3 = count;
+				} else {
+					semihosting->result = 0;
 				}
-				semihosting->hit_fileio = true;
-				fileio_info->identifier = "write";
-				fileio_info->param_1 = 1;
-				fileio_info->param_2 = semihosting->param;
-				fileio_info->param_3 = count;
-			} else {
-				uint64_t addr = semihosting->param;
-				do {
-					unsigned char c;
-					retval = target_read_memory(target, addr++, 1, 1, &c);
-					if (retval != ERROR_OK)
-						return retval;
-					if (!c)
-						break;
-					semihosting_putchar(semihosting, semihosting->stdout_fd, c);
-				} while (1);
-				semihosting->result = 0;
 			}
 			break;
 
@@ -1865,6 +2017,8 @@ COMMAND_HANDLER(handle_common_semihosting_command)
 
 		/* FIXME never let that "catch" be dropped! (???) */
 		semihosting->is_active = is_active;
+		if (!is_active)
+			semihosting_console_flush(semihosting);
 	}
 
 	command_print(CMD, "semihosting is %s",
@@ -2052,6 +2206,83 @@ COMMAND_HANDLER(handle_common_semihosting_resumable_exit_command)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(handle_common_semihosting_buffered_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+
+	if (!target) {
+		LOG_ERROR("No target selected");
+		return ERROR_FAIL;
+	}
+
+	struct semihosting *semihosting = target->semihosting;
+	if (!semihosting) {
+		command_print(CMD, "semihosting not supported for current target");
+		return ERROR_FAIL;
+	}
+
+	if (!semihosting->is_active) {
+		command_print(CMD, "semihosting not yet enabled for current target");
+		return ERROR_FAIL;
+	}
+
+	if (CMD_ARGC > 0) {
+		COMMAND_PARSE_ENABLE(CMD_ARGV[0], semihosting->is_buffered);
+		if (!semihosting->is_buffered)
+			semihosting_console_flush(semihosting);
+	}
+
+	command_print(CMD, "semihosting console buffering is %s",
+		semihosting->is_buffered
+		? "enabled" : "disabled");
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_common_semihosting_statistics_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+
+	if (!target) {
+		LOG_ERROR("No target selected");
+		return ERROR_FAIL;
+	}
+
+	struct semihosting *semihosting = target->semihosting;
+	if (!semihosting) {
+		command_print(CMD, "semihosting not supported for current target");
+		return ERROR_FAIL;
+	}
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		if (strcmp(CMD_ARGV[0], "reset"))
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		memset(semihosting->stats, 0, sizeof(semihosting->stats));
+		return ERROR_OK;
+	}
+
+	command_print(CMD, "%-22s %10s %12s %10s %10s", "operation", "count",
+		"total (ms)", "mean (us)", "max (us)");
+
+	for (int i = 0; i < SEMIHOSTING_STATS_OPS; i++) {
+		const struct semihosting_op_stats *stats = &semihosting->stats[i];
+
+		if (stats->count == 0)
+			continue;
+
+		int op = semihosting_stats_op(i);
+		command_print(CMD, "0x%03x %-16s %10u %12.3f %10.1f %10.1f",
+			op, semihosting_opcode_to_str(op), stats->count,
+			stats->total * 1e3, stats->total * 1e6 / stats->count,
+			stats->max * 1e6);
+	}
+
+	return ERROR_OK;
+}
+
 COMMAND_HANDLER(handle_common_semihosting_read_user_param_command)
 {
 	struct target *target = get_current_target(CMD_CTX);
@@ -2150,6 +2381,20 @@ const struct command_registration semihosting_common_handlers[] = {
 		.usage = "['enable'|'disable']",
 		.help = "activate support for semihosting resumable exit",
 	},
+	{
+		.name = "semihosting_buffered",
+		.handler = handle_common_semihosting_buffered_command,
+		.mode = COMMAND_EXEC,
+		.usage = "['enable'|'disable']",
+		.help = "coalesce semihosting console output until end of line",
+	},
+	{
+		.name = "semihosting_statistics",
+		.handler = handle_common_semihosting_statistics_command,
+		.mode = COMMAND_EXEC,
+		.usage = "['reset']",
+		.help = "display or reset the time spent in each semihosting operation",
+	},
 	{
 		.name = "semihosting_read_user_param",
 		.handler = handle_common_semihosting_read_user_param_command,
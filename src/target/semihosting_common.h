@@ -101,6 +101,21 @@ enum semihosting_result {
 	SEMIHOSTING_ERROR		/* Something went wrong. */
 };
 
+/** Size of the buffer coalescing WRITEC and WRITE0 console output */
+#define SEMIHOSTING_CONSOLE_BUF_SIZE 1024
+
+/** Number of operations with timing statistics: ARM ones, then user ones */
+#define SEMIHOSTING_STATS_OPS \
+	(SEMIHOSTING_ARM_RESERVED_START + SEMIHOSTING_USER_CMD_0X107 - \
+	 SEMIHOSTING_USER_CMD_0X100 + 1)
+
+/** Time spent servicing one semihosting operation */
+struct semihosting_op_stats {
+	unsigned int count;
+	float total;	/* seconds */
+	float max;		/* seconds */
+};
+
 struct target;
 
 /*
@@ -149,6 +164,20 @@ struct semihosting {
 	 */
 	bool has_resumable_exit;
 
+	/**
+	 * When set, console output of WRITEC and WRITE0 is kept in console_buf
+	 * until a newline is written, the buffer is full or another operation
+	 * is requested, so that a single write reaches the host console.
+	 */
+	bool is_buffered;
+
+	/** Pending console output, see is_buffered. */
+	uint8_t console_buf[SEMIHOSTING_CONSOLE_BUF_SIZE];
+	size_t console_len;
+
+	/** Per-operation servicing time, see semihosting_statistics. */
+	struct semihosting_op_stats stats[SEMIHOSTING_STATS_OPS];
+
 	/** The Target (hart) word size; 8 for 64-bits targets. */
 	size_t word_size_bytes;
 
@@ -197,6 +226,7 @@ const char *semihosting_opcode_to_str(uint64_t opcode);
 
 int semihosting_common_init(struct target *target, void *setup,
 	void *post_result);
+void semihosting_common_free(struct target *target);
 int semihosting_common(struct target *target);
 
 /* utility functions which may also be used by semihosting extensions (custom vendor-defined syscalls) */
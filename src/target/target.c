@@ -919,6 +919,20 @@ done:
 	return retval;
 }
 
+/* Count the number of bytes that can be written to the fifo without crossing
+ * the wrap around. Make sure to not fill it completely, because that would
+ * make wp == rp and that's the empty condition. */
+static uint32_t async_fifo_free_bytes(uint32_t rp, uint32_t wp,
+		uint32_t fifo_start_addr, uint32_t fifo_end_addr, int block_size)
+{
+	if (rp > wp)
+		return rp - wp - block_size;
+	else if (rp > fifo_start_addr)
+		return fifo_end_addr - wp;
+	else
+		return fifo_end_addr - wp - block_size;
+}
+
 /**
  * Streams data to a circular buffer on target intended for consumption by code
  * running asynchronously on target.
@@ -970,7 +984,6 @@ int target_run_flash_async_algorithm(struct target *target,
 		uint32_t entry_point, uint32_t exit_point, void *arch_info)
 {
 	int retval;
-	int timeout = 0;
 
 	const uint8_t *buffer_orig = buffer;
 
@@ -1006,58 +1019,83 @@ int target_run_flash_async_algorithm(struct target *target,
 		return retval;
 	}
 
-	while (count > 0) {
+	/* How fast the target drains the fifo, in bytes per ms, to wait about
+	 * the right time when it's full. */
+	uint32_t fifo_size = fifo_end_addr - fifo_start_addr;
+	uint32_t drain_rate = 0;
+	uint32_t rate_rp = rp;
+	int64_t rate_time = timeval_ms();
+	int64_t progress_time = rate_time;
 
-		retval = target_read_u32(target, rp_addr, &rp);
-		if (retval != ERROR_OK) {
-			LOG_ERROR("failed to get read pointer");
-			break;
-		}
+	while (count > 0) {
+		/* The read pointer only moves forward, so the space left by its last
+		 * known value can be filled without polling it again. */
+		uint32_t thisrun_bytes = async_fifo_free_bytes(rp, wp, fifo_start_addr,
+				fifo_end_addr, block_size);
+		uint32_t wanted_bytes = MIN(fifo_size / 4, count * block_size);
+
+		if (thisrun_bytes == 0 || (rp > wp && thisrun_bytes < wanted_bytes)) {
+			retval = target_read_u32(target, rp_addr, &rp);
+			if (retval != ERROR_OK) {
+				LOG_ERROR("failed to get read pointer");
+				break;
+			}
 
-		LOG_DEBUG("offs 0x%zx count 0x%" PRIx32 " wp 0x%" PRIx32 " rp 0x%" PRIx32,
-			(size_t) (buffer - buffer_orig), count, wp, rp);
+			LOG_DEBUG("offs 0x%zx count 0x%" PRIx32 " wp 0x%" PRIx32 " rp 0x%" PRIx32,
+				(size_t)(buffer - buffer_orig), count, wp, rp);
 
-		if (rp == 0) {
-			LOG_ERROR("flash write algorithm aborted by target");
-			retval = ERROR_FLASH_OPERATION_FAILED;
-			break;
-		}
-
-		if (!IS_ALIGNED(rp - fifo_start_addr, block_size) || rp < fifo_start_addr || rp >= fifo_end_addr) {
-			LOG_ERROR("corrupted fifo read pointer 0x%" PRIx32, rp);
-			break;
-		}
+			if (rp == 0) {
+				LOG_ERROR("flash write algorithm aborted by target");
+				retval = ERROR_FLASH_OPERATION_FAILED;
+				break;
+			}
 
-		/* Count the number of bytes available in the fifo without
-		 * crossing the wrap around. Make sure to not fill it completely,
-		 * because that would make wp == rp and that's the empty condition. */
-		uint32_t thisrun_bytes;
-		if (rp > wp)
-			thisrun_bytes = rp - wp - block_size;
-		else if (rp > fifo_start_addr)
-			thisrun_bytes = fifo_end_addr - wp;
-		else
-			thisrun_bytes = fifo_end_addr - wp - block_size;
+			if (!IS_ALIGNED(rp - fifo_start_addr, block_size) || rp < fifo_start_addr || rp >= fifo_end_addr) {
+				LOG_ERROR("corrupted fifo read pointer 0x%" PRIx32, rp);
+				break;
+			}
 
-		if (thisrun_bytes == 0) {
-			/* Throttle polling a bit if transfer is (much) faster than flash
-			 * programming. The exact delay shouldn't matter as long as it's
-			 * less than buffer size / flash speed. This is very unlikely to
-			 * run when using high latency connections such as USB. */
-			alive_sleep(2);
+			int64_t now = timeval_ms();
+			if (rp != rate_rp) {
+				progress_time = now;
+				if (now > rate_time) {
+					uint32_t drained = rp > rate_rp ? rp - rate_rp : fifo_size - (rate_rp - rp);
+					drain_rate = drained / (now - rate_time);
+					rate_time = now;
+					rate_rp = rp;
+				}
+			}
 
-			/* to stop an infinite loop on some targets check and increment a timeout
-			 * this issue was observed on a stellaris using the new ICDI interface */
-			if (timeout++ >= 2500) {
-				LOG_ERROR("timeout waiting for algorithm, a target reset is recommended");
-				return ERROR_FLASH_OPERATION_FAILED;
+			thisrun_bytes = async_fifo_free_bytes(rp, wp, fifo_start_addr,
+					fifo_end_addr, block_size);
+
+			/* Unless the target drains the fifo faster than it can be polled,
+			 * let a quarter of it drain, so that each write is worth its round
+			 * trip.  Waiting less than the fifo takes to drain is enough to
+			 * never starve the target. */
+			if (thisrun_bytes == 0 || (rp > wp && thisrun_bytes < wanted_bytes)) {
+				unsigned int delay = 0;
+				if (drain_rate)
+					delay = MIN((wanted_bytes - thisrun_bytes) / drain_rate, 50);
+				else if (thisrun_bytes == 0)
+					delay = 2;
+
+				if (delay || !thisrun_bytes) {
+					/* to stop an infinite loop on some targets check for a timeout
+					 * this issue was observed on a stellaris using the new ICDI interface */
+					if (now - progress_time >= 5000) {
+						LOG_ERROR("timeout waiting for algorithm, a target reset is recommended");
+						return ERROR_FLASH_OPERATION_FAILED;
+					}
+					if (delay)
+						alive_sleep(delay);
+					else
+						keep_alive();
+					continue;
+				}
 			}
-			continue;
 		}
 
-		/* reset our timeout */
-		timeout = 0;
-
 		/* Limit to the amount of data we actually want to write */
 		if (thisrun_bytes > count * block_size)
 			thisrun_bytes = count * block_size;
@@ -1115,6 +1153,113 @@ int target_run_flash_async_algorithm(struct target *target,
 	return retval;
 }
 
+/**
+ * Runs an algorithm that programs a chunk of data from a buffer on the target
+ * and returns, like target_run_algorithm() would in a loop, but keeps the link
+ * busy while the target programs.
+ *
+ * The buffer on the target is split in two halves. While the algorithm runs on
+ * the chunk in one half, the next chunk is written to the other half. Targets
+ * that can't access their memory while running get the chunks written between
+ * the runs instead.
+ *
+ * @param target used to run the algorithm
+ * @param buffer address on the host where data to be sent is located
+ * @param count number of blocks to send
+ * @param block_size size in bytes of each block, chunks are made of whole blocks
+ * @param num_reg_params count of register-based params to pass to algorithm
+ * @param reg_params register-based params to pass to algorithm
+ * @param buffer_start address on the target of the buffer
+ * @param buffer_size size of the buffer, which must hold two blocks
+ * @param entry_point address on the target to execute to start the algorithm
+ * @param exit_point address at which to set a breakpoint to catch the
+ *     end of the algorithm; can be 0 if target triggers a breakpoint itself
+ * @param timeout_ms how long to wait for the algorithm to program a chunk
+ * @param arch_info
+ * @param ops hooks setting the params of each run and checking its results
+ * @param priv passed to the hooks
+ */
+int target_run_flash_pingpong_algorithm(struct target *target,
+		const uint8_t *buffer, uint32_t count, int block_size,
+		int num_reg_params, struct reg_param *reg_params,
+		uint32_t buffer_start, uint32_t buffer_size,
+		uint32_t entry_point, uint32_t exit_point, unsigned int timeout_ms,
+		void *arch_info, const struct target_pingpong_ops *ops, void *priv)
+{
+	uint32_t half_count = buffer_size / 2 / block_size;
+	if (half_count == 0)
+		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+
+	uint32_t source[2] = { buffer_start, buffer_start + half_count * block_size };
+	unsigned int current = 0;
+	bool overlap = true;
+	uint32_t offset = 0;
+	uint32_t thisrun_count = MIN(count, half_count);
+
+	int retval = target_write_buffer(target, source[current],
+			thisrun_count * block_size, buffer);
+	if (retval != ERROR_OK)
+		return retval;
+
+	while (count > 0) {
+		retval = ops->prepare(target, priv, source[current], offset,
+				thisrun_count, reg_params);
+		if (retval != ERROR_OK)
+			return retval;
+
+		retval = target_start_algorithm(target, 0, NULL,
+				num_reg_params, reg_params, entry_point, exit_point, arch_info);
+		if (retval != ERROR_OK) {
+			LOG_ERROR("error starting target flash write algorithm");
+			return retval;
+		}
+
+		/* Send the next chunk while the target programs this one */
+		uint32_t next_offset = offset + thisrun_count * block_size;
+		uint32_t next_count = MIN(count - thisrun_count, half_count);
+		bool next_written = false;
+		if (next_count && overlap) {
+			if (target_write_buffer(target, source[!current], next_count * block_size,
+					buffer + next_offset) == ERROR_OK) {
+				next_written = true;
+			} else {
+				LOG_DEBUG("can't write memory while the algorithm runs");
+				overlap = false;
+			}
+		}
+
+		retval = target_wait_algorithm(target, 0, NULL,
+				num_reg_params, reg_params, exit_point, timeout_ms, arch_info);
+		if (retval != ERROR_OK) {
+			LOG_ERROR("error waiting for target flash write algorithm");
+			return retval;
+		}
+
+		if (ops->check) {
+			retval = ops->check(target, priv, reg_params);
+			if (retval != ERROR_OK)
+				return retval;
+		}
+
+		count -= thisrun_count;
+		offset = next_offset;
+		thisrun_count = next_count;
+		current = !current;
+
+		if (thisrun_count && !next_written) {
+			retval = target_write_buffer(target, source[current],
+					thisrun_count * block_size, buffer + offset);
+			if (retval != ERROR_OK)
+				return retval;
+		}
+
+		/* Avoid GDB timeouts */
+		keep_alive();
+	}
+
+	return ERROR_OK;
+}
+
 int target_run_read_async_algorithm(struct target *target,
 		uint8_t *buffer, uint32_t count, int block_size,
 		int num_mem_params, struct mem_param *mem_params,
@@ -1304,6 +1449,7 @@ int target_write_memory(struct target *target,
 		LOG_ERROR("Target %s doesn't support write_memory", target_name(target));
 		return ERROR_FAIL;
 	}
+	rtos_reg_cache_invalidate(target);
 	return target->type->write_memory(target, address, size, count, buffer);
 }
 
@@ -1318,6 +1464,7 @@ int target_write_phys_memory(struct target *target,
 		LOG_ERROR("Target %s doesn't support write_phys_memory", target_name(target));
 		return ERROR_FAIL;
 	}
+	rtos_reg_cache_invalidate(target);
 	return target->type->write_phys_memory(target, address, size, count, buffer);
 }
 
@@ -1496,10 +1643,10 @@ unsigned int target_data_bits(struct target *target)
 }
 
 static int target_profiling(struct target *target, uint32_t *samples,
-			uint32_t max_num_samples, uint32_t *num_samples, uint32_t seconds)
+			uint32_t max_num_samples, uint32_t *num_samples, uint32_t timeout_ms)
 {
 	return target->type->profiling(target, samples, max_num_samples,
-			num_samples, seconds);
+			num_samples, timeout_ms);
 }
 
 static int handle_target(void *priv);
@@ -1949,6 +2096,9 @@ static void target_split_working_area(struct working_area *area, uint32_t size)
 			return;
 
 		new_wa->next = area->next;
+		new_wa->prev = area;
+		if (new_wa->next)
+			new_wa->next->prev = new_wa;
 		new_wa->size = area->size - size;
 		new_wa->address = area->address + size;
 		new_wa->backup = NULL;
@@ -1965,33 +2115,55 @@ static void target_split_working_area(struct working_area *area, uint32_t size)
 	}
 }
 
+/* Merge the area following area into it */
+static void target_merge_next_working_area(struct working_area *area)
+{
+	struct working_area *to_be_freed = area->next;
+
+	assert(to_be_freed->address == area->address + area->size); /* This is an invariant */
+
+	area->size += to_be_freed->size;
+	area->next = to_be_freed->next;
+	if (area->next)
+		area->next->prev = area;
+	free(to_be_freed->backup);
+	free(to_be_freed);
+
+	/* If backup memory was allocated to the remaining area, it's has
+	 * the wrong size now */
+	free(area->backup);
+	area->backup = NULL;
+}
+
+/* Merge a newly freed area with its free neighbours, if any */
+static void target_merge_working_area(struct target *target, struct working_area *area)
+{
+	if (area->next && area->next->free)
+		target_merge_next_working_area(area);
+
+	if (area->prev && area->prev->free) {
+		area = area->prev;
+		target_merge_next_working_area(area);
+	}
+
+	if (target->working_area_largest_valid && area->size > target->working_area_largest)
+		target->working_area_largest = area->size;
+}
+
 /* Merge all adjacent free areas into one */
 static void target_merge_working_areas(struct target *target)
 {
 	struct working_area *c = target->working_areas;
 
 	while (c && c->next) {
-		assert(c->next->address == c->address + c->size); /* This is an invariant */
-
 		/* Find two adjacent free areas */
-		if (c->free && c->next->free) {
-			/* Merge the last into the first */
-			c->size += c->next->size;
-
-			/* Remove the last */
-			struct working_area *to_be_freed = c->next;
-			c->next = c->next->next;
-			free(to_be_freed->backup);
-			free(to_be_freed);
-
-			/* If backup memory was allocated to the remaining area, it's has
-			 * the wrong size now */
-			free(c->backup);
-			c->backup = NULL;
-		} else {
+		if (c->free && c->next->free)
+			target_merge_next_working_area(c);
+		else
 			c = c->next;
-		}
 	}
+
+	target->working_area_largest_valid = false;
 }
 
 int target_alloc_working_area_try(struct target *target, uint32_t size, struct working_area **area)
@@ -2033,6 +2205,7 @@ int target_alloc_working_area_try(struct target *target, uint32_t size, struct w
 		struct working_area *new_wa = malloc(sizeof(*new_wa));
 		if (new_wa) {
 			new_wa->next = NULL;
+			new_wa->prev = NULL;
 			new_wa->size = ALIGN_DOWN(target->working_area_size, 4); /* 4-byte align */
 			new_wa->address = target->working_area;
 			new_wa->backup = NULL;
@@ -2041,11 +2214,16 @@ int target_alloc_working_area_try(struct target *target, uint32_t size, struct w
 		}
 
 		target->working_areas = new_wa;
+		target->working_area_largest = new_wa ? new_wa->size : 0;
+		target->working_area_largest_valid = true;
 	}
 
 	/* only allocate multiples of 4 byte */
 	size = ALIGN_UP(size, 4);
 
+	if (target->working_area_largest_valid && size > target->working_area_largest)
+		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+
 	struct working_area *c = target->working_areas;
 
 	/* Find the first large enough working area */
@@ -2058,6 +2236,10 @@ int target_alloc_working_area_try(struct target *target, uint32_t size, struct w
 	if (!c)
 		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
 
+	/* The largest free area has to be looked up again if this was it */
+	if (c->size == target->working_area_largest)
+		target->working_area_largest_valid = false;
+
 	/* Split the working area into the requested size */
 	target_split_working_area(c, size);
 
@@ -2139,7 +2321,7 @@ static int target_free_working_area_restore(struct target *target, struct workin
 	*area->user = NULL;
 	area->user = NULL;
 
-	target_merge_working_areas(target);
+	target_merge_working_area(target, area);
 
 	print_wa_layout(target);
 
@@ -2189,6 +2371,7 @@ void target_free_all_working_areas(struct target *target)
 		free(target->working_areas);
 		target->working_areas = NULL;
 	}
+	target->working_area_largest_valid = false;
 }
 
 /* Find the largest number of bytes that can be allocated */
@@ -2200,6 +2383,9 @@ uint32_t target_get_working_area_avail(struct target *target)
 	if (!c)
 		return ALIGN_DOWN(target->working_area_size, 4);
 
+	if (target->working_area_largest_valid)
+		return target->working_area_largest;
+
 	while (c) {
 		if (c->free && max_size < c->size)
 			max_size = c->size;
@@ -2207,6 +2393,9 @@ uint32_t target_get_working_area_avail(struct target *target)
 		c = c->next;
 	}
 
+	target->working_area_largest = max_size;
+	target->working_area_largest_valid = true;
+
 	return max_size;
 }
 
@@ -2215,9 +2404,7 @@ static void target_destroy(struct target *target)
 	if (target->type->deinit_target)
 		target->type->deinit_target(target);
 
-	if (target->semihosting)
-		free(target->semihosting->basedir);
-	free(target->semihosting);
+	semihosting_common_free(target);
 
 	jtag_unregister_event_callback(jtag_enable_callback, target);
 
@@ -2316,14 +2503,14 @@ static int target_gdb_fileio_end_default(struct target *target,
 }
 
 int target_profiling_default(struct target *target, uint32_t *samples,
-		uint32_t max_num_samples, uint32_t *num_samples, uint32_t seconds)
+		uint32_t max_num_samples, uint32_t *num_samples, uint32_t timeout_ms)
 {
 	struct timeval timeout, now;
 
 	gettimeofday(&timeout, NULL);
-	timeval_add_time(&timeout, seconds, 0);
+	timeval_add_time(&timeout, timeout_ms / 1000, (timeout_ms % 1000) * 1000);
 
-	LOG_INFO("Starting profiling. Halting and resuming the"
+	LOG_DEBUG("Starting profiling. Halting and resuming the"
 			" target as often as we can...");
 
 	uint32_t sample_count = 0;
@@ -2354,7 +2541,7 @@ int target_profiling_default(struct target *target, uint32_t *samples,
 
 		gettimeofday(&now, NULL);
 		if ((sample_count >= max_num_samples) || timeval_compare(&now, &timeout) >= 0) {
-			LOG_INFO("Profiling completed. %" PRIu32 " samples.", sample_count);
+			LOG_DEBUG("Profiling completed. %" PRIu32 " samples.", sample_count);
 			break;
 		}
 	}
@@ -2388,6 +2575,7 @@ int target_write_buffer(struct target *target, target_addr_t address, uint32_t s
 		return ERROR_FAIL;
 	}
 
+	rtos_reg_cache_invalidate(target);
 	return target->type->write_buffer(target, address, size, buffer);
 }
 
@@ -3157,6 +3345,7 @@ COMMAND_HANDLER(handle_reg_command)
 			return ERROR_FAIL;
 		str_to_buf(CMD_ARGV[1], strlen(CMD_ARGV[1]), buf, reg->size, 0);
 
+		rtos_reg_cache_invalidate(target);
 		int retval = reg->type->set(reg, buf);
 		if (retval != ERROR_OK) {
 			LOG_ERROR("Could not write to register '%s'", reg->name);
@@ -4284,6 +4473,110 @@ static void write_gmon(uint32_t *samples, uint32_t sample_num, const char *filen
 	fclose(f);
 }
 
+/* Number of samples requested from target_profiling() in one go. Sampling
+ * is repeated in chunks of this size until the requested time is over, so
+ * neither the duration nor the sample rate is bounded by a single buffer. */
+#define PROFILE_CHUNK_SAMPLES (64 * 1024)
+
+/* Sample the PC for the given time, handing each chunk of samples to the
+ * handler as soon as it is available. The run state of the target is the
+ * same afterwards as it was before. */
+static int target_profile_chunks(struct target *target, uint32_t seconds,
+		int (*handler)(const uint32_t *samples, uint32_t num_samples, void *priv),
+		void *priv, uint32_t *duration_ms)
+{
+	bool halted_before_profiling = target->state == TARGET_HALTED;
+	int retval = ERROR_OK;
+
+	uint32_t *samples = malloc(sizeof(uint32_t) * PROFILE_CHUNK_SAMPLES);
+	if (!samples) {
+		LOG_ERROR("No memory to store samples.");
+		return ERROR_FAIL;
+	}
+
+	LOG_INFO("Starting profiling...");
+
+	int64_t timestart_ms = timeval_ms();
+	int64_t timeend_ms = timestart_ms + seconds * 1000LL;
+	uint64_t total_samples = 0;
+	uint32_t num_of_samples;
+	do {
+		int64_t now_ms = timeval_ms();
+		uint32_t chunk_ms = now_ms < timeend_ms ? timeend_ms - now_ms : 0;
+
+		/**
+		 * Some cores let us sample the PC without the
+		 * annoying halt/resume step; for example, ARMv7 PCSR.
+		 * Provide a way to use that more efficient mechanism.
+		 */
+		retval = target_profiling(target, samples, PROFILE_CHUNK_SAMPLES,
+					&num_of_samples, chunk_ms);
+		if (retval != ERROR_OK)
+			break;
+
+		assert(num_of_samples <= PROFILE_CHUNK_SAMPLES);
+		total_samples += num_of_samples;
+
+		retval = handler(samples, num_of_samples, priv);
+		if (retval != ERROR_OK)
+			break;
+
+		/* a chunk that is not full means that the time is over */
+	} while (num_of_samples == PROFILE_CHUNK_SAMPLES && timeval_ms() < timeend_ms);
+	*duration_ms = timeval_ms() - timestart_ms;
+
+	free(samples);
+	if (retval != ERROR_OK)
+		return retval;
+
+	LOG_INFO("Profiling completed. %" PRIu64 " samples.", total_samples);
+
+	retval = target_poll(target);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (target->state == TARGET_RUNNING && halted_before_profiling) {
+		/* The target was halted before we started and is running now. Halt it,
+		 * for consistency. */
+		retval = target_halt(target);
+		if (retval != ERROR_OK)
+			return retval;
+	} else if (target->state == TARGET_HALTED && !halted_before_profiling) {
+		/* The target was running before we started and is halted now. Resume
+		 * it, for consistency. */
+		retval = target_resume(target, 1, 0, 0, 0);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	return target_poll(target);
+}
+
+struct profile_samples {
+	uint32_t *samples;
+	uint32_t num_samples;
+};
+
+static int profile_store_chunk(const uint32_t *samples, uint32_t num_samples, void *priv)
+{
+	struct profile_samples *all = priv;
+
+	if (num_samples == 0)
+		return ERROR_OK;
+
+	uint32_t *tmp = realloc(all->samples,
+			sizeof(uint32_t) * (all->num_samples + num_samples));
+	if (!tmp) {
+		LOG_ERROR("No memory to store samples.");
+		return ERROR_FAIL;
+	}
+
+	memcpy(tmp + all->num_samples, samples, sizeof(uint32_t) * num_samples);
+	all->samples = tmp;
+	all->num_samples += num_samples;
+	return ERROR_OK;
+}
+
 /* profiling samples the CPU PC as quickly as OpenOCD is able,
  * which will be used as a random sampling of PC */
 COMMAND_HANDLER(handle_profile_command)
@@ -4293,11 +4586,9 @@ COMMAND_HANDLER(handle_profile_command)
 	if ((CMD_ARGC != 2) && (CMD_ARGC != 4))
 		return ERROR_COMMAND_SYNTAX_ERROR;
 
-	const uint32_t MAX_PROFILE_SAMPLE_NUM = 10000;
 	uint32_t offset;
-	uint32_t num_of_samples;
+	uint32_t duration_ms;
 	int retval = ERROR_OK;
-	bool halted_before_profiling = target->state == TARGET_HALTED;
 
 	COMMAND_PARSE_NUMBER(u32, CMD_ARGV[0], offset);
 
@@ -4314,64 +4605,68 @@ COMMAND_HANDLER(handle_profile_command)
 		}
 	}
 
-	uint32_t *samples = malloc(sizeof(uint32_t) * MAX_PROFILE_SAMPLE_NUM);
-	if (!samples) {
-		LOG_ERROR("No memory to store samples.");
-		return ERROR_FAIL;
-	}
-
-	uint64_t timestart_ms = timeval_ms();
-	/**
-	 * Some cores let us sample the PC without the
-	 * annoying halt/resume step; for example, ARMv7 PCSR.
-	 * Provide a way to use that more efficient mechanism.
-	 */
-	retval = target_profiling(target, samples, MAX_PROFILE_SAMPLE_NUM,
-				&num_of_samples, offset);
+	struct profile_samples all = { NULL, 0 };
+	retval = target_profile_chunks(target, offset, profile_store_chunk, &all,
+			&duration_ms);
 	if (retval != ERROR_OK) {
-		free(samples);
+		free(all.samples);
 		return retval;
 	}
-	uint32_t duration_ms = timeval_ms() - timestart_ms;
 
-	assert(num_of_samples <= MAX_PROFILE_SAMPLE_NUM);
+	if (all.num_samples == 0) {
+		command_print(CMD, "No samples taken");
+		return ERROR_FAIL;
+	}
+
+	write_gmon(all.samples, all.num_samples, CMD_ARGV[1],
+		   with_range, start_address, end_address, target, duration_ms);
+	command_print(CMD, "Wrote %s", CMD_ARGV[1]);
 
-	retval = target_poll(target);
-	if (retval != ERROR_OK) {
-		free(samples);
-		return retval;
+	free(all.samples);
+	return retval;
+}
+
+static int profile_stream_chunk(const uint32_t *samples, uint32_t num_samples, void *priv)
+{
+	FILE *f = priv;
+
+	for (uint32_t i = 0; i < num_samples; i++)
+		fprintf(f, "0x%08" PRIx32 "\n", samples[i]);
+
+	/* make each chunk visible to a reader right away */
+	if (fflush(f) != 0) {
+		LOG_ERROR("Error writing samples");
+		return ERROR_FAIL;
 	}
+	return ERROR_OK;
+}
 
-	if (target->state == TARGET_RUNNING && halted_before_profiling) {
-		/* The target was halted before we started and is running now. Halt it,
-		 * for consistency. */
-		retval = target_halt(target);
-		if (retval != ERROR_OK) {
-			free(samples);
-			return retval;
-		}
-	} else if (target->state == TARGET_HALTED && !halted_before_profiling) {
-		/* The target was running before we started and is halted now. Resume
-		 * it, for consistency. */
-		retval = target_resume(target, 1, 0, 0, 0);
-		if (retval != ERROR_OK) {
-			free(samples);
-			return retval;
-		}
+/* like profile, but writes every sampled PC as text while sampling */
+COMMAND_HANDLER(handle_profile_stream_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+
+	if (CMD_ARGC != 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	uint32_t offset;
+	uint32_t duration_ms;
+	COMMAND_PARSE_NUMBER(u32, CMD_ARGV[0], offset);
+
+	FILE *f = fopen(CMD_ARGV[1], "w");
+	if (!f) {
+		command_print(CMD, "Can't open %s", CMD_ARGV[1]);
+		return ERROR_FAIL;
 	}
 
-	retval = target_poll(target);
-	if (retval != ERROR_OK) {
-		free(samples);
+	int retval = target_profile_chunks(target, offset, profile_stream_chunk, f,
+			&duration_ms);
+	fclose(f);
+	if (retval != ERROR_OK)
 		return retval;
-	}
 
-	write_gmon(samples, num_of_samples, CMD_ARGV[1],
-		   with_range, start_address, end_address, target, duration_ms);
 	command_print(CMD, "Wrote %s", CMD_ARGV[1]);
-
-	free(samples);
-	return retval;
+	return ERROR_OK;
 }
 
 static int new_u64_array_element(Jim_Interp *interp, const char *varname, int idx, uint64_t val)
@@ -5177,7 +5472,7 @@ static int target_jim_set_reg(Jim_Interp *interp, int argc,
 	const unsigned int length = tmp;
 	struct command_context *cmd_ctx = current_command_context(interp);
 	assert(cmd_ctx);
-	const struct target *target = get_current_target(cmd_ctx);
+	struct target *target = get_current_target(cmd_ctx);
 
 	for (unsigned int i = 0; i < length; i += 2) {
 		const char *reg_name = Jim_String(dict[i]);
@@ -5198,6 +5493,7 @@ static int target_jim_set_reg(Jim_Interp *interp, int argc,
 		}
 
 		str_to_buf(reg_value, strlen(reg_value), buf, reg->size, 0);
+		rtos_reg_cache_invalidate(target);
 		int retval = reg->type->set(reg, buf);
 		free(buf);
 
@@ -6897,6 +7193,14 @@ static const struct command_registration target_exec_command_handlers[] = {
 		.usage = "seconds filename [start end]",
 		.help = "profiling samples the CPU PC",
 	},
+	{
+		.name = "profile_stream",
+		.handler = handle_profile_stream_command,
+		.mode = COMMAND_EXEC,
+		.usage = "seconds filename",
+		.help = "profiling samples the CPU PC, writing them to a file "
+			"or pipe while sampling",
+	},
 	/** @todo don't register virt2phys() unless target supports it */
 	{
 		.name = "virt2phys",
@@ -88,6 +88,7 @@ struct working_area {
 	uint8_t *backup;
 	struct working_area **user;
 	struct working_area *next;
+	struct working_area *prev;
 };
 
 struct gdb_service {
@@ -151,6 +152,8 @@ struct target {
 	uint32_t working_area_size;			/* size in bytes */
 	uint32_t backup_working_area;		/* whether the content of the working area has to be preserved */
 	struct working_area *working_areas;/* list of allocated working areas */
+	uint32_t working_area_largest;		/* cached size of the largest free working area */
+	bool working_area_largest_valid;	/* whether working_area_largest is up to date */
 	enum target_debug_reason debug_reason;/* reason why the target entered debug state */
 	enum target_endianness endianness;	/* target endianness */
 	/* also see: target_state_name() */
@@ -583,6 +586,27 @@ int target_run_flash_async_algorithm(struct target *target,
 		uint32_t entry_point, uint32_t exit_point,
 		void *arch_info);
 
+/** Hooks of target_run_flash_pingpong_algorithm(). */
+struct target_pingpong_ops {
+	/** Sets @a reg_params to program @a count blocks found at @a source on
+	 * the target, which are at @a offset bytes from the start of the data. */
+	int (*prepare)(struct target *target, void *priv, uint32_t source,
+			uint32_t offset, uint32_t count, struct reg_param *reg_params);
+	/** Optional, checks the results of the algorithm in @a reg_params. */
+	int (*check)(struct target *target, void *priv, struct reg_param *reg_params);
+};
+
+/**
+ * Runs a block based flash algorithm once per chunk of data, sending the next
+ * chunk to the other half of the buffer while the target programs this one.
+ */
+int target_run_flash_pingpong_algorithm(struct target *target,
+		const uint8_t *buffer, uint32_t count, int block_size,
+		int num_reg_params, struct reg_param *reg_params,
+		uint32_t buffer_start, uint32_t buffer_size,
+		uint32_t entry_point, uint32_t exit_point, unsigned int timeout_ms,
+		void *arch_info, const struct target_pingpong_ops *ops, void *priv);
+
 /**
  * This routine is a wrapper for asynchronous algorithms.
  *
@@ -783,7 +807,7 @@ void target_handle_md_output(struct command_invocation *cmd,
 	unsigned count, const uint8_t *buffer);
 
 int target_profiling_default(struct target *target, uint32_t *samples, uint32_t
-		max_num_samples, uint32_t *num_samples, uint32_t seconds);
+		max_num_samples, uint32_t *num_samples, uint32_t timeout_ms);
 
 #define ERROR_TARGET_INVALID	(-300)
 #define ERROR_TARGET_INIT_FAILED (-301)
@@ -295,10 +295,10 @@ struct target_type {
 	 */
 	int (*gdb_query_custom)(struct target *target, const char *packet, char **response_p);
 
-	/* do target profiling
+	/* do target profiling for up to timeout_ms milliseconds
 	 */
 	int (*profiling)(struct target *target, uint32_t *samples,
-			uint32_t max_num_samples, uint32_t *num_samples, uint32_t seconds);
+			uint32_t max_num_samples, uint32_t *num_samples, uint32_t timeout_ms);
 
 	/* Return the number of address bits this target supports. This will
 	 * typically be 32 for 32-bit targets, and 64 for 64-bit targets. If not